@@ -34,6 +34,10 @@ bool any_transport::connected() const {
   return transport_ && transport_->connected();
 }
 
+std::optional<ReceiveTimestamp> any_transport::last_receive_timestamp() const {
+  return transport_ ? transport_->last_receive_timestamp() : std::nullopt;
+}
+
 awaitable<error_code> any_transport::open() {
   if (!transport_) {
     co_return ERR_INVALID_HANDLE;
@@ -39,6 +39,7 @@ class any_transport {
   [[nodiscard]] bool message_oriented() const;
   [[nodiscard]] bool active() const;
   [[nodiscard]] bool connected() const;
+  [[nodiscard]] std::optional<ReceiveTimestamp> last_receive_timestamp() const;
 
   [[nodiscard]] awaitable<error_code> open();
   [[nodiscard]] awaitable<error_code> close();
@@ -47,6 +48,10 @@ class any_transport {
   [[nodiscard]] awaitable<expected<size_t>> write(
       std::span<const char> data) const;
 
+  // The underlying transport, e.g. to reach the API of a specific transport
+  // with `dynamic_cast`.
+  [[nodiscard]] Transport* get() const { return transport_.get(); }
+
  private:
   std::unique_ptr<Transport> transport_;
 };
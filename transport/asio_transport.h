@@ -11,6 +11,7 @@
 #include <boost/asio/use_awaitable.hpp>
 #include <boost/asio/write.hpp>
 #include <memory>
+#include <utility>
 
 namespace transport {
 
@@ -38,6 +39,10 @@ class AsioTransport : public Transport {
  protected:
   AsioTransport(const executor& executor, const log_source& log);
 
+  // Constructs the I/O object from `args`.
+  template <class... Args>
+  AsioTransport(const log_source& log, std::in_place_t, Args&&... args);
+
   void ProcessError(error_code error);
 
   // Must be called under `io_object_.get_executor()`.
@@ -57,6 +62,13 @@ inline AsioTransport<IoObject>::AsioTransport(const executor& executor,
                                               const log_source& log)
     : log_{std::move(log)}, io_object_{executor} {}
 
+template <class IoObject>
+template <class... Args>
+inline AsioTransport<IoObject>::AsioTransport(const log_source& log,
+                                              std::in_place_t,
+                                              Args&&... args)
+    : log_{log}, io_object_{std::forward<Args>(args)...} {}
+
 template <class IoObject>
 inline awaitable<error_code> AsioTransport<IoObject>::close() {
   co_await boost::asio::dispatch(io_object_.get_executor(),
@@ -96,7 +96,7 @@ class ByteMessage {
       throw std::runtime_error{"Too much data to pop"};
     }
 
-    std::rotate(data, data + count, data + size);
+    memmove(data, data + count, size - count);
     size -= count;
 
     if (pos >= count) {
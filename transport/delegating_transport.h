@@ -32,6 +32,11 @@ class DelegatingTransport : public Transport {
     return delegate_.write(data);
   }
 
+  [[nodiscard]] virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const override {
+    return delegate_.last_receive_timestamp();
+  }
+
   [[nodiscard]] virtual std::string name() const override {
     return delegate_.name();
   }
@@ -0,0 +1,173 @@
+#include "transport/delimiter_message_reader.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSPORT_DELIMITER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace transport {
+
+namespace {
+
+constexpr char kLf = '\n';
+constexpr char kCr = '\r';
+constexpr char kStx = '\x02';
+constexpr char kEtx = '\x03';
+
+// Fits a number of small messages arriving together.
+constexpr size_t kInitialBufferSize = 4096;
+
+// Returns `end` if there is no `byte` in the range.
+const char* FindByte(const char* begin, const char* end, char byte) {
+  const char* p = begin;
+
+#if defined(__AVX2__)
+  const __m256i pattern = _mm256_set1_epi8(byte);
+  for (; end - p >= 32; p += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const auto mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern)));
+    if (mask != 0)
+      return p + std::countr_zero(mask);
+  }
+#elif defined(TRANSPORT_DELIMITER_SSE2)
+  const __m128i pattern = _mm_set1_epi8(byte);
+  for (; end - p >= 16; p += 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const auto mask = static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+    if (mask != 0)
+      return p + std::countr_zero(mask);
+  }
+#endif
+
+  // The tail, or all of it without SIMD.
+  for (; p != end; ++p) {
+    if (*p == byte)
+      return p;
+  }
+  return end;
+}
+
+}  // namespace
+
+DelimiterMessageReader::DelimiterMessageReader(
+    const DelimiterFraming& framing,
+    std::shared_ptr<MessageBufferPool> pool)
+    : GrowableMessageReader{std::move(pool),
+                            std::min(kInitialBufferSize,
+                                     framing.max_message_size),
+                            framing.max_message_size},
+      framing_{framing} {
+  set_error_correction(true);
+}
+
+MessageReader* DelimiterMessageReader::Clone() {
+  auto* clone = new DelimiterMessageReader(framing_, pool());
+  clone->set_error_correction(has_error_correction());
+  return clone;
+}
+
+bool DelimiterMessageReader::GetBytesExpected(const void* buf,
+                                              size_t len,
+                                              size_t& expected) const {
+  // The data up to the next delimiter belongs to a dropped message, so it fails
+  // until `GetBytesToSkip` passes it.
+  if (discarding_) {
+    expected = 1;
+    return len == 0;
+  }
+
+  if (scan_position_ != read_position()) {
+    scan_position_ = read_position();
+    scanned_ = 0;
+  }
+
+  const auto* data = static_cast<const char*>(buf);
+  const bool stx_etx = framing_.type == DelimiterFraming::Type::STX_ETX;
+  if (stx_etx && len != 0 && data[0] != kStx) {
+    log().write(LogSeverity::Warning, "Message doesn't start with STX");
+    return false;
+  }
+
+  const char terminator = stx_etx ? kEtx : kLf;
+  size_t start = std::max<size_t>(scanned_, stx_etx ? 1 : 0);
+  for (;;) {
+    const char* found = FindByte(data + std::min(start, len), data + len,
+                                 terminator);
+    const size_t index = static_cast<size_t>(found - data);
+    if (index == len) {
+      break;
+    }
+    if (framing_.type == DelimiterFraming::Type::CRLF &&
+        (index == 0 || data[index - 1] != kCr)) {
+      start = index + 1;
+      continue;
+    }
+
+    // Repeated calls for the same message find the delimiter at once.
+    scanned_ = index;
+    if (index + 1 > framing_.max_message_size) {
+      log().write(LogSeverity::Warning,
+                  "Message of {} bytes exceeds the maximum of {} bytes",
+                  index + 1, framing_.max_message_size);
+      return false;
+    }
+    expected = index + 1;
+    return true;
+  }
+
+  scanned_ = len;
+  if (len >= framing_.max_message_size) {
+    log().write(LogSeverity::Warning,
+                "No delimiter within the maximum message size of {} bytes",
+                framing_.max_message_size);
+    return false;
+  }
+
+  // Asks for one more byte at a time, while reads take what's there.
+  expected = len + 1;
+  return true;
+}
+
+size_t DelimiterMessageReader::GetBytesToSkip(const void* buf,
+                                              size_t len) const {
+  const auto* data = static_cast<const char*>(buf);
+
+  // Up to the start of the next message.
+  if (framing_.type == DelimiterFraming::Type::STX_ETX)
+    return static_cast<size_t>(FindByte(data + 1, data + len, kStx) - data);
+
+  // Through the end of the current one, which may continue in later reads.
+  const bool crlf = framing_.type == DelimiterFraming::Type::CRLF;
+  for (size_t start = 0;;) {
+    const size_t index =
+        static_cast<size_t>(FindByte(data + start, data + len, kLf) - data);
+    if (index == len) {
+      discarded_cr_ = len != 0 && data[len - 1] == kCr;
+      discarding_ = true;
+      return len;
+    }
+    if (crlf && !(index == 0 ? discarding_ && discarded_cr_
+                             : data[index - 1] == kCr)) {
+      start = index + 1;
+      continue;
+    }
+    discarding_ = false;
+    return index + 1;
+  }
+}
+
+void DelimiterMessageReader::OnReset() {
+  discarding_ = false;
+}
+
+}  // namespace transport
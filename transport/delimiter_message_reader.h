@@ -0,0 +1,65 @@
+#pragma once
+
+#include "transport/growable_message_reader.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace transport {
+
+// Delimiter-based message framings of serial and legacy TCP devices.
+struct DelimiterFraming {
+  enum class Type {
+    // Messages end with LF.
+    LF,
+    // Messages end with CR LF. A bare LF is part of the message.
+    CRLF,
+    // Messages start with STX (0x02) and end with ETX (0x03).
+    STX_ETX,
+  };
+
+  Type type = Type::LF;
+  // Larger messages fail the read. Includes the delimiters.
+  size_t max_message_size = 64 * 1024;
+};
+
+// Splits a stream at delimiters, which are searched with SIMD instructions
+// when available. The delimiters are kept in the messages. Bytes already
+// scanned for the current message are not scanned again.
+//
+// Error correction is on, so that after an invalid message the reader skips
+// straight to the next delimiter instead of a byte at a time. The rest of a
+// message that is too long is skipped as it arrives, so its tail isn't taken
+// for a message.
+class DelimiterMessageReader final : public GrowableMessageReader {
+ public:
+  DelimiterMessageReader(const DelimiterFraming& framing,
+                         std::shared_ptr<MessageBufferPool> pool);
+
+  const DelimiterFraming& framing() const { return framing_; }
+
+  // MessageReader
+  [[nodiscard]] MessageReader* Clone() override;
+
+ protected:
+  // MessageReader
+  bool GetBytesExpected(const void* buf,
+                        size_t len,
+                        size_t& expected) const override;
+  size_t GetBytesToSkip(const void* buf, size_t len) const override;
+  void OnReset() override;
+
+ private:
+  const DelimiterFraming framing_;
+
+  // The bytes of the message at `scan_position_` scanned so far.
+  mutable uint64_t scan_position_ = 0;
+  mutable size_t scanned_ = 0;
+
+  // Set while skipping the rest of a message past the received data. The CR
+  // is remembered if the skipped data ended with one.
+  mutable bool discarding_ = false;
+  mutable bool discarded_cr_ = false;
+};
+
+}  // namespace transport
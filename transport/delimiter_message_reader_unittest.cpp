@@ -0,0 +1,130 @@
+#include "transport/delimiter_message_reader.h"
+
+#include <gmock/gmock.h>
+#include <array>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace transport {
+namespace {
+
+DelimiterMessageReader MakeReader(const DelimiterFraming& framing) {
+  return DelimiterMessageReader{framing,
+                                std::make_shared<MessageBufferPool>()};
+}
+
+// Copies `data` into the reader as a single read.
+void Feed(MessageReader& reader, std::string_view data) {
+  auto buffer = reader.Prepare();
+  ASSERT_GE(buffer.size(), data.size());
+  std::ranges::copy(data, buffer.begin());
+  reader.BytesRead(data.size());
+}
+
+// Returns the error as `"!"`.
+std::string Pop(MessageReader& reader) {
+  std::array<char, 256> buffer;
+  auto bytes_popped = reader.Pop(buffer);
+  if (!bytes_popped.ok())
+    return "!";
+  return {buffer.data(), *bytes_popped};
+}
+
+// Pops the valid messages, skipping the invalid data as
+// `MessageReaderTransport` does.
+std::vector<std::string> PopAll(MessageReader& reader) {
+  std::vector<std::string> messages;
+  for (;;) {
+    auto message = Pop(reader);
+    if (message == "!") {
+      if (!reader.TryCorrectError())
+        break;
+    } else if (message.empty()) {
+      break;
+    } else {
+      messages.push_back(std::move(message));
+    }
+  }
+  return messages;
+}
+
+}  // namespace
+
+TEST(DelimiterMessageReaderTest, SplitsAtLf) {
+  auto reader = MakeReader({.type = DelimiterFraming::Type::LF});
+
+  Feed(reader, "abc\n\nde");
+  EXPECT_EQ(Pop(reader), "abc\n");
+  EXPECT_EQ(Pop(reader), "\n");
+  EXPECT_EQ(Pop(reader), "");
+  Feed(reader, "f\n");
+  EXPECT_EQ(Pop(reader), "def\n");
+  EXPECT_TRUE(reader.IsEmpty());
+}
+
+TEST(DelimiterMessageReaderTest, CrLfKeepsBareLf) {
+  auto reader = MakeReader({.type = DelimiterFraming::Type::CRLF});
+
+  Feed(reader, "a\nb\r");
+  EXPECT_EQ(Pop(reader), "");
+  Feed(reader, "\nc\r\n");
+  EXPECT_EQ(Pop(reader), "a\nb\r\n");
+  EXPECT_EQ(Pop(reader), "c\r\n");
+}
+
+// Covers the vector chunks and the scalar tail.
+TEST(DelimiterMessageReaderTest, FindsDelimiterAtAnyOffset) {
+  auto reader = MakeReader({.type = DelimiterFraming::Type::LF});
+
+  for (size_t size = 0; size < 100; ++size) {
+    const auto message = std::string(size, 'x') + '\n';
+    Feed(reader, message);
+    EXPECT_EQ(Pop(reader), message);
+  }
+}
+
+TEST(DelimiterMessageReaderTest, StxEtxSkipsToNextStx) {
+  auto reader = MakeReader({.type = DelimiterFraming::Type::STX_ETX});
+
+  Feed(reader, "noise\x03\x02msg\x03");
+  EXPECT_EQ(Pop(reader), "!");
+  EXPECT_TRUE(reader.TryCorrectError());
+  EXPECT_EQ(Pop(reader), "\x02msg\x03");
+}
+
+TEST(DelimiterMessageReaderTest, ResyncsAfterCorruptBurstAtOnce) {
+  auto reader = MakeReader(
+      {.type = DelimiterFraming::Type::LF, .max_message_size = 1024});
+
+  // No delimiter within the maximum message size.
+  Feed(reader, std::string(1024, 'x'));
+  EXPECT_THAT(PopAll(reader), IsEmpty());
+  EXPECT_TRUE(reader.IsEmpty());
+
+  // The rest of the long message is skipped too.
+  Feed(reader, std::string(100, 'x') + "\nok\n");
+  EXPECT_THAT(PopAll(reader), ElementsAre("ok\n"));
+}
+
+TEST(DelimiterMessageReaderTest, CrLfResyncSkipsThroughCrLf) {
+  auto reader = MakeReader(
+      {.type = DelimiterFraming::Type::CRLF, .max_message_size = 1024});
+
+  // The CR and the LF ending the long message arrive apart.
+  Feed(reader, std::string(1023, 'x') + '\r');
+  EXPECT_THAT(PopAll(reader), IsEmpty());
+
+  Feed(reader, "\nok\r\n");
+  EXPECT_THAT(PopAll(reader), ElementsAre("ok\r\n"));
+
+  // A bare LF doesn't end the long message.
+  Feed(reader, std::string(1024, 'y'));
+  EXPECT_THAT(PopAll(reader), IsEmpty());
+
+  Feed(reader, "y\ny\r\nok\r\n");
+  EXPECT_THAT(PopAll(reader), ElementsAre("ok\r\n"));
+}
+
+}  // namespace transport
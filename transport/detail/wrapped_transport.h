@@ -21,6 +21,14 @@ class WrappedTransport final : public Transport {
 
   bool connected() const override { return impl_.connected(); }
 
+  std::optional<ReceiveTimestamp> last_receive_timestamp() const override {
+    if constexpr (requires(const T& t) { t.last_receive_timestamp(); }) {
+      return impl_.last_receive_timestamp();
+    } else {
+      return std::nullopt;
+    }
+  }
+
   awaitable<error_code> open() override { co_return co_await impl_.open(); }
 
   awaitable<error_code> close() override { co_return co_await impl_.close(); }
@@ -26,6 +26,8 @@ constexpr error_code ERR_IO_PENDING = boost::system::errc::make_error_code(
     boost::system::errc::resource_unavailable_try_again);
 constexpr error_code ERR_NOT_IMPLEMENTED = boost::system::errc::make_error_code(
     boost::system::errc::function_not_supported);
+constexpr error_code ERR_NOT_SUPPORTED = boost::system::errc::make_error_code(
+    boost::system::errc::operation_not_supported);
 constexpr error_code ERR_TIMED_OUT =
     boost::system::errc::make_error_code(boost::system::errc::timed_out);
 constexpr error_code ERR_SSL_BAD_PEER_PUBLIC_KEY =
@@ -36,8 +38,6 @@ constexpr error_code ERR_CONNECTION_REFUSED =
     boost::system::errc::make_error_code(boost::system::errc::connection_refused);
 constexpr error_code ERR_NOT_FOUND =
     boost::system::errc::make_error_code(boost::system::errc::no_such_file_or_directory);
-constexpr error_code ERR_NOT_SUPPORTED =
-    boost::system::errc::make_error_code(boost::system::errc::operation_not_supported);
 constexpr error_code ERR_FAILED =
     boost::system::errc::operation_canceled;
 constexpr error_code ERR_INTERNAL =
@@ -0,0 +1,467 @@
+#include "transport/fragmenting_transport.h"
+
+#include "transport/auto_reset.h"
+#include "transport/error.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace transport {
+
+namespace {
+
+// The maximum child message size accepted by `read`.
+constexpr size_t kMaxDatagramSize = 64 * 1024;
+
+constexpr size_t kMaxFragmentCount = 0xFFFF;
+
+// Message IDs wrap around. Partial messages this many IDs behind the newest
+// message are dropped, so a reused ID can't complete them with fragments of
+// another message.
+constexpr uint16_t kMessageIdWindow = 1024;
+
+// How far `message_id` is behind `newest_message_id`. Values of 0x8000 and
+// above mean that `message_id` is ahead.
+uint16_t GetMessageIdAge(uint16_t newest_message_id, uint16_t message_id) {
+  return static_cast<uint16_t>(newest_message_id - message_id);
+}
+
+struct FragmentHeader {
+  uint16_t message_id = 0;
+  uint16_t index = 0;
+  uint16_t count = 0;
+};
+
+void PutUint16(char* p, uint16_t value) {
+  p[0] = static_cast<char>(value & 0xFF);
+  p[1] = static_cast<char>(value >> 8);
+}
+
+uint16_t GetUint16(const char* p) {
+  return static_cast<uint16_t>(static_cast<uint8_t>(p[0]) |
+                               (static_cast<uint8_t>(p[1]) << 8));
+}
+
+void WriteFragmentHeader(const FragmentHeader& header, char* p) {
+  PutUint16(p, header.message_id);
+  PutUint16(p + 2, header.index);
+  PutUint16(p + 4, header.count);
+}
+
+FragmentHeader ReadFragmentHeader(const char* p) {
+  return {.message_id = GetUint16(p),
+          .index = GetUint16(p + 2),
+          .count = GetUint16(p + 4)};
+}
+
+}  // namespace
+
+// FragmentingTransport::Core
+
+struct FragmentingTransport::Core : std::enable_shared_from_this<Core> {
+  Core(any_transport child_transport,
+       const Options& options,
+       const log_source& log)
+      : child_transport_{std::move(child_transport)},
+        options_{options},
+        log_{log} {
+    assert(options_.mtu > kHeaderSize);
+  }
+
+  [[nodiscard]] awaitable<error_code> Open();
+  [[nodiscard]] awaitable<error_code> Close();
+
+  [[nodiscard]] awaitable<expected<size_t>> ReadMessage(std::span<char> buffer);
+
+  [[nodiscard]] awaitable<expected<size_t>> WriteMessage(
+      std::span<const char> data);
+
+  // Returns the size of a message completed by the fragment and copied into
+  // `buffer`, or nothing if the message is not complete yet.
+  std::optional<expected<size_t>> HandleFragment(
+      std::span<const char> fragment,
+      std::span<char> buffer);
+
+  struct PartialMessage {
+    uint16_t message_id = 0;
+    uint16_t fragment_count = 0;
+    size_t received_count = 0;
+    // The payload size of all fragments except the last one. Zero until the
+    // first of them is received.
+    size_t fragment_size = 0;
+    // Payloads of all fragments except the last one.
+    std::vector<char> data;
+    std::vector<char> last_fragment;
+    std::vector<bool> received;
+    std::chrono::steady_clock::time_point start_time;
+  };
+
+  // Returns false if a fragment of the message must be dropped, as the
+  // message is too far behind the newest one.
+  bool TrackMessageId(uint16_t message_id, bool fragmented);
+
+  PartialMessage& GetPartialMessage(const FragmentHeader& header);
+  void DropPartialMessage(uint16_t message_id, std::string_view reason);
+  void DropExpiredPartialMessages();
+
+  static expected<size_t> CopyMessage(std::span<const char> payload,
+                                      std::span<char> buffer);
+
+  any_transport child_transport_;
+  const Options options_;
+  log_source log_;
+
+  bool reading_ = false;
+  std::vector<char> read_buffer_;
+
+  uint16_t next_message_id_ = 0;
+
+  std::optional<uint16_t> newest_message_id_;
+
+  // Ordered by start time.
+  std::vector<PartialMessage> partial_messages_;
+};
+
+awaitable<error_code> FragmentingTransport::Core::Open() {
+  partial_messages_.clear();
+  newest_message_id_.reset();
+  co_return co_await child_transport_.open();
+}
+
+awaitable<error_code> FragmentingTransport::Core::Close() {
+  partial_messages_.clear();
+  newest_message_id_.reset();
+  co_return co_await child_transport_.close();
+}
+
+awaitable<expected<size_t>> FragmentingTransport::Core::ReadMessage(
+    std::span<char> buffer) {
+  if (!child_transport_) {
+    co_return ERR_INVALID_HANDLE;
+  }
+
+  if (reading_) {
+    co_return ERR_IO_PENDING;
+  }
+
+  auto ref = shared_from_this();
+  AutoReset reading{reading_, true};
+
+  if (read_buffer_.empty()) {
+    read_buffer_.resize(kMaxDatagramSize);
+  }
+
+  for (;;) {
+    auto bytes_read = co_await child_transport_.read(read_buffer_);
+
+    if (!child_transport_) {
+      co_return ERR_ABORTED;
+    }
+
+    if (!bytes_read.ok() || *bytes_read == 0) {
+      co_return bytes_read;
+    }
+
+    if (auto message_size = HandleFragment(
+            std::span{read_buffer_}.first(*bytes_read), buffer)) {
+      co_return *message_size;
+    }
+  }
+}
+
+std::optional<expected<size_t>> FragmentingTransport::Core::HandleFragment(
+    std::span<const char> fragment,
+    std::span<char> buffer) {
+  if (fragment.size() < kHeaderSize) {
+    log_.write(LogSeverity::Warning, "Fragment is too short");
+    return std::nullopt;
+  }
+
+  const auto header = ReadFragmentHeader(fragment.data());
+  const auto payload = fragment.subspan(kHeaderSize);
+
+  if (header.count == 0 || header.index >= header.count) {
+    log_.write(LogSeverity::Warning, "Invalid fragment header");
+    return std::nullopt;
+  }
+
+  // Expired messages don't hold back the IDs of a restarted peer.
+  DropExpiredPartialMessages();
+
+  if (!TrackMessageId(header.message_id, /*fragmented=*/header.count != 1)) {
+    log_.write(LogSeverity::Warning, "Drop fragment of stale message {}",
+               header.message_id);
+    return std::nullopt;
+  }
+
+  // Fast path for messages that fit a single fragment.
+  if (header.count == 1) {
+    return CopyMessage(payload, buffer);
+  }
+
+  auto& message = GetPartialMessage(header);
+  if (message.received[header.index]) {
+    return std::nullopt;
+  }
+
+  if (header.index == header.count - 1) {
+    if (message.fragment_size != 0 && payload.size() > message.fragment_size) {
+      DropPartialMessage(header.message_id, "Last fragment is too long");
+      return std::nullopt;
+    }
+    message.last_fragment.assign(payload.begin(), payload.end());
+
+  } else {
+    if (message.fragment_size == 0) {
+      if (payload.empty() ||
+          payload.size() > options_.max_message_size / (header.count - 1) ||
+          message.last_fragment.size() > payload.size()) {
+        DropPartialMessage(header.message_id, "Invalid fragment size");
+        return std::nullopt;
+      }
+      message.fragment_size = payload.size();
+      message.data.resize(message.fragment_size * (header.count - 1));
+
+    } else if (payload.size() != message.fragment_size) {
+      DropPartialMessage(header.message_id, "Fragment size mismatch");
+      return std::nullopt;
+    }
+
+    std::ranges::copy(payload, message.data.begin() +
+                                   header.index * message.fragment_size);
+  }
+
+  message.received[header.index] = true;
+  if (++message.received_count != message.fragment_count) {
+    return std::nullopt;
+  }
+
+  const size_t message_size =
+      message.data.size() + message.last_fragment.size();
+  if (message_size > options_.max_message_size) {
+    DropPartialMessage(header.message_id, "Message is too long");
+    return std::nullopt;
+  }
+
+  if (buffer.size() < message_size) {
+    DropPartialMessage(header.message_id, "Read buffer is too small");
+    return ERR_INVALID_ARGUMENT;
+  }
+
+  std::ranges::copy(message.data, buffer.begin());
+  std::ranges::copy(message.last_fragment,
+                    buffer.begin() + message.data.size());
+
+  std::erase_if(partial_messages_, [&](const PartialMessage& m) {
+    return m.message_id == header.message_id;
+  });
+
+  return message_size;
+}
+
+bool FragmentingTransport::Core::TrackMessageId(uint16_t message_id,
+                                                bool fragmented) {
+  // Without partial messages any ID is accepted, so a restarted peer is not
+  // taken for a stale one.
+  if (newest_message_id_ && !partial_messages_.empty()) {
+    const uint16_t age = GetMessageIdAge(*newest_message_id_, message_id);
+    if (age < 0x8000) {
+      // Messages that fit a single fragment can't be mixed up.
+      return !fragmented || age < kMessageIdWindow;
+    }
+  }
+
+  newest_message_id_ = message_id;
+
+  std::vector<uint16_t> stale_message_ids;
+  for (const auto& message : partial_messages_) {
+    if (GetMessageIdAge(message_id, message.message_id) >= kMessageIdWindow) {
+      stale_message_ids.push_back(message.message_id);
+    }
+  }
+
+  for (uint16_t stale_message_id : stale_message_ids) {
+    DropPartialMessage(stale_message_id, "Message ID is too old");
+  }
+
+  return true;
+}
+
+FragmentingTransport::Core::PartialMessage&
+FragmentingTransport::Core::GetPartialMessage(const FragmentHeader& header) {
+  auto i = std::ranges::find(partial_messages_, header.message_id,
+                             &PartialMessage::message_id);
+
+  // The peer may have wrapped around the message IDs.
+  if (i != partial_messages_.end() && i->fragment_count != header.count) {
+    DropPartialMessage(header.message_id, "Fragment count mismatch");
+    i = partial_messages_.end();
+  }
+
+  if (i != partial_messages_.end()) {
+    return *i;
+  }
+
+  if (!partial_messages_.empty() &&
+      partial_messages_.size() >= options_.max_partial_messages) {
+    DropPartialMessage(partial_messages_.front().message_id,
+                       "Too many partial messages");
+  }
+
+  auto& message = partial_messages_.emplace_back();
+  message.message_id = header.message_id;
+  message.fragment_count = header.count;
+  message.received.resize(header.count);
+  message.start_time = std::chrono::steady_clock::now();
+  return message;
+}
+
+void FragmentingTransport::Core::DropPartialMessage(uint16_t message_id,
+                                                    std::string_view reason) {
+  log_.write(LogSeverity::Warning, "Drop partial message {}: {}", message_id,
+             reason);
+
+  std::erase_if(partial_messages_, [message_id](const PartialMessage& m) {
+    return m.message_id == message_id;
+  });
+}
+
+void FragmentingTransport::Core::DropExpiredPartialMessages() {
+  const auto deadline =
+      std::chrono::steady_clock::now() - options_.reassembly_timeout;
+
+  while (!partial_messages_.empty() &&
+         partial_messages_.front().start_time < deadline) {
+    DropPartialMessage(partial_messages_.front().message_id,
+                       "Reassembly timed out");
+  }
+}
+
+// static
+expected<size_t> FragmentingTransport::Core::CopyMessage(
+    std::span<const char> payload,
+    std::span<char> buffer) {
+  if (buffer.size() < payload.size()) {
+    return ERR_INVALID_ARGUMENT;
+  }
+
+  std::ranges::copy(payload, buffer.begin());
+  return payload.size();
+}
+
+awaitable<expected<size_t>> FragmentingTransport::Core::WriteMessage(
+    std::span<const char> data) {
+  if (!child_transport_) {
+    co_return ERR_INVALID_HANDLE;
+  }
+
+  const size_t fragment_size = options_.mtu - kHeaderSize;
+  const size_t fragment_count =
+      std::max<size_t>(1, (data.size() + fragment_size - 1) / fragment_size);
+  if (data.size() > options_.max_message_size ||
+      fragment_count > kMaxFragmentCount) {
+    co_return ERR_INVALID_ARGUMENT;
+  }
+
+  auto ref = shared_from_this();
+
+  FragmentHeader header{.message_id = next_message_id_++,
+                        .count = static_cast<uint16_t>(fragment_count)};
+
+  std::vector<char> fragment;
+  fragment.reserve(kHeaderSize + std::min(fragment_size, data.size()));
+
+  for (size_t i = 0; i < fragment_count; ++i) {
+    const auto payload =
+        data.subspan(i * fragment_size,
+                     std::min(fragment_size, data.size() - i * fragment_size));
+
+    header.index = static_cast<uint16_t>(i);
+    fragment.resize(kHeaderSize);
+    WriteFragmentHeader(header, fragment.data());
+    fragment.insert(fragment.end(), payload.begin(), payload.end());
+
+    NET_ASSIGN_OR_CO_RETURN(auto bytes_written,
+                            co_await child_transport_.write(fragment));
+    (void)bytes_written;
+
+    if (!child_transport_) {
+      co_return ERR_ABORTED;
+    }
+  }
+
+  co_return data.size();
+}
+
+// FragmentingTransport
+
+FragmentingTransport::FragmentingTransport(any_transport child_transport,
+                                           const Options& options,
+                                           const log_source& log)
+    : core_{std::make_shared<Core>(std::move(child_transport), options, log)} {
+  assert(core_->child_transport_);
+  assert(core_->child_transport_.message_oriented());
+}
+
+FragmentingTransport::~FragmentingTransport() {
+  core_->child_transport_.reset();
+}
+
+awaitable<error_code> FragmentingTransport::open() {
+  return core_->Open();
+}
+
+awaitable<error_code> FragmentingTransport::close() {
+  return core_->Close();
+}
+
+awaitable<expected<any_transport>> FragmentingTransport::accept() {
+  auto core = core_;
+
+  NET_ASSIGN_OR_CO_RETURN(auto accepted_child_transport,
+                          co_await core->child_transport_.accept());
+
+  co_return any_transport{std::make_unique<FragmentingTransport>(
+      std::move(accepted_child_transport), core->options_, core->log_)};
+}
+
+awaitable<expected<size_t>> FragmentingTransport::read(std::span<char> data) {
+  return core_->ReadMessage(data);
+}
+
+awaitable<expected<size_t>> FragmentingTransport::write(
+    std::span<const char> data) {
+  return core_->WriteMessage(data);
+}
+
+// The time of the fragment that completed the message.
+std::optional<ReceiveTimestamp> FragmentingTransport::last_receive_timestamp()
+    const {
+  return core_->child_transport_.last_receive_timestamp();
+}
+
+std::string FragmentingTransport::name() const {
+  return "FRAG:" + core_->child_transport_.name();
+}
+
+bool FragmentingTransport::message_oriented() const {
+  return true;
+}
+
+bool FragmentingTransport::connected() const {
+  return core_->child_transport_.connected();
+}
+
+bool FragmentingTransport::active() const {
+  return core_->child_transport_.active();
+}
+
+executor FragmentingTransport::get_executor() {
+  return core_->child_transport_.get_executor();
+}
+
+}  // namespace transport
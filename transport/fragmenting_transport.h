@@ -0,0 +1,70 @@
+#pragma once
+
+#include "transport/any_transport.h"
+#include "transport/executor.h"
+#include "transport/log.h"
+#include "transport/transport.h"
+
+#include <chrono>
+#include <memory>
+
+namespace transport {
+
+// A message-oriented transport that splits messages into fragments fitting a
+// single datagram of a message-oriented child transport, such as UDP, and
+// reassembles them on the receiving side.
+//
+// Each fragment starts with a header of three little-endian 16-bit fields: the
+// message ID, the fragment index and the fragment count. All fragments of a
+// message except the last one carry the same number of bytes. Lost fragments
+// are not retransmitted: a message is delivered only if all its fragments
+// arrive within the reassembly timeout. As message IDs wrap around, a partial
+// message is also dropped once the peer is 1024 messages ahead of it.
+class FragmentingTransport final : public Transport {
+ public:
+  struct Options {
+    // The maximum child message size, including the fragment header.
+    size_t mtu = 1200;
+    // Larger messages are rejected by `write` and dropped on reassembly.
+    size_t max_message_size = 1024 * 1024;
+    // The maximum number of messages being reassembled at once. The oldest
+    // partial message is dropped when a new one doesn't fit.
+    size_t max_partial_messages = 16;
+    // Partial messages not completed in time are dropped.
+    std::chrono::milliseconds reassembly_timeout{5000};
+  };
+
+  static constexpr size_t kHeaderSize = 6;
+
+  FragmentingTransport(any_transport child_transport,
+                       const Options& options,
+                       const log_source& log = {});
+  virtual ~FragmentingTransport();
+
+  // Transport
+  [[nodiscard]] virtual awaitable<error_code> open() override;
+  [[nodiscard]] virtual awaitable<error_code> close() override;
+
+  [[nodiscard]] virtual awaitable<expected<any_transport>> accept() override;
+
+  [[nodiscard]] virtual awaitable<expected<size_t>> read(
+      std::span<char> data) override;
+
+  [[nodiscard]] virtual awaitable<expected<size_t>> write(
+      std::span<const char> data) override;
+
+  virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const override;
+  virtual std::string name() const override;
+  virtual bool message_oriented() const override;
+  virtual bool connected() const override;
+  virtual bool active() const override;
+  virtual executor get_executor() override;
+
+ private:
+  struct Core;
+
+  const std::shared_ptr<Core> core_;
+};
+
+}  // namespace transport
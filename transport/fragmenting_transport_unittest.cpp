@@ -0,0 +1,265 @@
+#include "transport/fragmenting_transport.h"
+
+#include "transport/test/coroutine_util.h"
+#include "transport/transport_mock.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <gmock/gmock.h>
+#include <thread>
+
+using namespace testing;
+
+namespace transport {
+
+class FragmentingTransportTest : public Test {
+ public:
+  void CreateFragmentingTransport(const FragmentingTransport::Options& options);
+
+  // Makes the child transport deliver the written fragments in the specified
+  // order.
+  void DeliverFragments(const std::vector<size_t>& indexes);
+
+  [[nodiscard]] awaitable<expected<std::vector<char>>> ReadMessage();
+
+  TransportMock* child_transport_ = nullptr;
+
+  std::vector<std::vector<char>> written_fragments_;
+
+  // GMock clears mutable captured variables, so we need to store the fragments
+  // in a shared pointer.
+  const std::shared_ptr<std::deque<std::vector<char>>> incoming_fragments_ =
+      std::make_shared<std::deque<std::vector<char>>>();
+
+  std::unique_ptr<FragmentingTransport> fragmenting_transport_;
+};
+
+void FragmentingTransportTest::CreateFragmentingTransport(
+    const FragmentingTransport::Options& options) {
+  auto child_transport = std::make_unique<NiceMock<TransportMock>>();
+
+  ON_CALL(*child_transport, message_oriented()).WillByDefault(Return(true));
+  ON_CALL(*child_transport, open()).WillByDefault(CoReturn(OK));
+  ON_CALL(*child_transport, close()).WillByDefault(CoReturn(OK));
+  ON_CALL(*child_transport, connected()).WillByDefault(Return(true));
+
+  ON_CALL(*child_transport, write(/*data=*/_))
+      .WillByDefault(Invoke(
+          [this](std::span<const char> data) -> awaitable<expected<size_t>> {
+            written_fragments_.emplace_back(data.begin(), data.end());
+            co_return data.size();
+          }));
+
+  ON_CALL(*child_transport, read(/*data=*/_))
+      .WillByDefault(
+          Invoke([incoming_fragments = incoming_fragments_](
+                     std::span<char> data) -> awaitable<expected<size_t>> {
+            if (incoming_fragments->empty()) {
+              co_return ERR_ABORTED;
+            }
+            auto fragment = std::move(incoming_fragments->front());
+            incoming_fragments->pop_front();
+            if (data.size() < fragment.size()) {
+              co_return ERR_FAILED;
+            }
+            std::ranges::copy(fragment, data.begin());
+            co_return fragment.size();
+          }));
+
+  child_transport_ = child_transport.get();
+
+  fragmenting_transport_ = std::make_unique<FragmentingTransport>(
+      any_transport{std::move(child_transport)}, options);
+}
+
+void FragmentingTransportTest::DeliverFragments(
+    const std::vector<size_t>& indexes) {
+  for (size_t index : indexes) {
+    incoming_fragments_->push_back(written_fragments_.at(index));
+  }
+}
+
+awaitable<expected<std::vector<char>>> FragmentingTransportTest::ReadMessage() {
+  std::vector<char> buffer(4096);
+  NET_ASSIGN_OR_CO_RETURN(auto bytes_read,
+                          co_await fragmenting_transport_->read(buffer));
+  buffer.resize(bytes_read);
+  co_return buffer;
+}
+
+std::vector<char> MakeMessage(size_t size) {
+  std::vector<char> message(size);
+  for (size_t i = 0; i < size; ++i) {
+    message[i] = static_cast<char>(i * 7);
+  }
+  return message;
+}
+
+TEST_F(FragmentingTransportTest, SplitsMessageIntoFragments) {
+  CoTest([&]() -> awaitable<void> {
+    CreateFragmentingTransport({.mtu = 16});
+    NET_EXPECT_OK(co_await fragmenting_transport_->open());
+
+    const auto message = MakeMessage(25);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message), message.size());
+
+    EXPECT_EQ(written_fragments_.size(), 3u);
+    if (written_fragments_.size() != 3u)
+      co_return;
+    EXPECT_EQ(written_fragments_[0].size(), 16u);
+    EXPECT_EQ(written_fragments_[1].size(), 16u);
+    EXPECT_EQ(written_fragments_[2].size(), 11u);
+
+    // Message ID, fragment index and fragment count.
+    EXPECT_THAT(std::span{written_fragments_[1]}.first(6),
+                ElementsAre(0, 0, 1, 0, 3, 0));
+  });
+}
+
+TEST_F(FragmentingTransportTest, ReassemblesReorderedFragments) {
+  CoTest([&]() -> awaitable<void> {
+    CreateFragmentingTransport({.mtu = 64});
+    NET_EXPECT_OK(co_await fragmenting_transport_->open());
+
+    const auto message = MakeMessage(1000);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message), message.size());
+    EXPECT_EQ(written_fragments_.size(), 18u);
+    if (written_fragments_.size() != 18u)
+      co_return;
+
+    // Deliver in reverse order with a duplicate.
+    std::vector<size_t> indexes(written_fragments_.size());
+    for (size_t i = 0; i < indexes.size(); ++i) {
+      indexes[i] = indexes.size() - 1 - i;
+    }
+    indexes.insert(indexes.begin() + 5, 3);
+    DeliverFragments(indexes);
+
+    EXPECT_EQ(co_await ReadMessage(), message);
+  });
+}
+
+TEST_F(FragmentingTransportTest, DropsOldestPartialMessageWhenLimitReached) {
+  CoTest([&]() -> awaitable<void> {
+    CreateFragmentingTransport({.mtu = 16, .max_partial_messages = 1});
+    NET_EXPECT_OK(co_await fragmenting_transport_->open());
+
+    const auto message1 = MakeMessage(20);
+    const auto message2 = MakeMessage(15);
+    const auto message3 = MakeMessage(5);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message1),
+              message1.size());
+    EXPECT_EQ(co_await fragmenting_transport_->write(message2),
+              message2.size());
+    EXPECT_EQ(co_await fragmenting_transport_->write(message3),
+              message3.size());
+    EXPECT_EQ(written_fragments_.size(), 5u);
+    if (written_fragments_.size() != 5u)
+      co_return;
+
+    // The first message is dropped when the second one starts.
+    DeliverFragments({0, 2, 3, 1, 4});
+
+    EXPECT_EQ(co_await ReadMessage(), message2);
+    EXPECT_EQ(co_await ReadMessage(), message3);
+  });
+}
+
+// A message that lost a fragment must not be completed by a fragment of a
+// later message reusing its ID after the IDs wrap around.
+TEST_F(FragmentingTransportTest, DropsPartialMessageOnMessageIdWraparound) {
+  CoTest([&]() -> awaitable<void> {
+    CreateFragmentingTransport({.mtu = 16});
+    NET_EXPECT_OK(co_await fragmenting_transport_->open());
+
+    const auto message1 = MakeMessage(25);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message1),
+              message1.size());
+
+    // Single-fragment messages with IDs 1 to 65535.
+    const std::vector<char> short_message{'x'};
+    for (size_t i = 1; i <= 0xFFFF; ++i) {
+      EXPECT_EQ(co_await fragmenting_transport_->write(short_message),
+                short_message.size());
+    }
+
+    // Reuses the ID of the first message.
+    auto message2 = MakeMessage(25);
+    std::ranges::reverse(message2);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message2),
+              message2.size());
+    EXPECT_EQ(written_fragments_.size(), 3u + 0xFFFF + 3u);
+    if (written_fragments_.size() != 3u + 0xFFFF + 3u)
+      co_return;
+
+    // The second fragment of the first message is lost. A few of the short
+    // messages arrive as the IDs advance.
+    const std::vector<size_t> short_message_ids{2000, 30000, 60000, 0xFFFF};
+    std::vector<size_t> indexes{0, 2};
+    for (size_t message_id : short_message_ids) {
+      indexes.push_back(2 + message_id);
+    }
+    const size_t message2_index = 3 + 0xFFFF;
+    indexes.insert(indexes.end(), {message2_index + 1, message2_index,
+                                   message2_index + 2});
+    DeliverFragments(indexes);
+
+    for (size_t i = 0; i < short_message_ids.size(); ++i) {
+      EXPECT_EQ(co_await ReadMessage(), short_message);
+    }
+    EXPECT_EQ(co_await ReadMessage(), message2);
+  });
+}
+
+// A peer restarting its message IDs is not taken for a stale one once the
+// pending partial message expires.
+TEST_F(FragmentingTransportTest, AcceptsRestartedMessageIdsAfterTimeout) {
+  CoTest([&]() -> awaitable<void> {
+    CreateFragmentingTransport(
+        {.mtu = 16, .reassembly_timeout = std::chrono::milliseconds{1}});
+    NET_EXPECT_OK(co_await fragmenting_transport_->open());
+
+    // The message with ID 0 plays the one sent after the restart.
+    const auto message1 = MakeMessage(25);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message1),
+              message1.size());
+
+    // Single-fragment messages with IDs 1 to 4999.
+    const std::vector<char> short_message{'x'};
+    for (size_t i = 1; i < 5000; ++i) {
+      EXPECT_EQ(co_await fragmenting_transport_->write(short_message),
+                short_message.size());
+    }
+
+    const auto message2 = MakeMessage(25);
+    EXPECT_EQ(co_await fragmenting_transport_->write(message2),
+              message2.size());
+    EXPECT_EQ(written_fragments_.size(), 3u + 4999u + 3u);
+    if (written_fragments_.size() != 3u + 4999u + 3u)
+      co_return;
+
+    // Only the first fragment of the message with ID 5000 arrives.
+    DeliverFragments({3 + 4999});
+    EXPECT_EQ(co_await ReadMessage(), ERR_ABORTED);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+
+    DeliverFragments({0, 1, 2});
+    EXPECT_EQ(co_await ReadMessage(), message1);
+  });
+}
+
+TEST_F(FragmentingTransportTest, RejectsTooLargeMessage) {
+  CoTest([&]() -> awaitable<void> {
+    CreateFragmentingTransport({.mtu = 16, .max_message_size = 100});
+    NET_EXPECT_OK(co_await fragmenting_transport_->open());
+
+    EXPECT_EQ(co_await fragmenting_transport_->write(MakeMessage(101)),
+              ERR_INVALID_ARGUMENT);
+    EXPECT_TRUE(written_fragments_.empty());
+  });
+}
+
+}  // namespace transport
@@ -0,0 +1,123 @@
+#include "transport/framing_message_reader.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace transport {
+
+namespace {
+
+// Fits a number of small messages arriving together.
+constexpr size_t kInitialBufferSize = 4096;
+
+size_t GetMaxMessageSize(const MessageFraming& framing) {
+  return framing.type == MessageFraming::Type::FIXED_SIZE
+             ? framing.record_size
+             : framing.max_message_size;
+}
+
+}  // namespace
+
+FramingMessageReader::FramingMessageReader(
+    const MessageFraming& framing,
+    std::shared_ptr<MessageBufferPool> pool)
+    : GrowableMessageReader{std::move(pool),
+                            std::min(kInitialBufferSize,
+                                     GetMaxMessageSize(framing)),
+                            GetMaxMessageSize(framing)},
+      framing_{framing} {
+  assert(IsValid(framing_));
+}
+
+// static
+bool FramingMessageReader::IsValid(const MessageFraming& framing) {
+  switch (framing.type) {
+    case MessageFraming::Type::LENGTH_PREFIX:
+      return (framing.length_bytes == 2 || framing.length_bytes == 4) &&
+             framing.max_message_size >
+                 framing.header_offset + framing.length_bytes;
+    case MessageFraming::Type::VARINT_PREFIX:
+      return framing.max_message_size > framing.header_offset + 1;
+    case MessageFraming::Type::FIXED_SIZE:
+      return framing.record_size != 0;
+  }
+  return false;
+}
+
+MessageReader* FramingMessageReader::Clone() {
+  return new FramingMessageReader(framing_, pool());
+}
+
+bool FramingMessageReader::GetBytesExpected(const void* buf,
+                                            size_t len,
+                                            size_t& expected) const {
+  if (cached_message_size_ != 0 && cached_position_ == read_position()) {
+    expected = cached_message_size_;
+    return true;
+  }
+
+  const auto* bytes = static_cast<const uint8_t*>(buf);
+
+  switch (framing_.type) {
+    case MessageFraming::Type::LENGTH_PREFIX: {
+      const size_t header_size = framing_.header_offset + framing_.length_bytes;
+      if (len < header_size) {
+        expected = header_size;
+        return true;
+      }
+
+      const uint8_t* prefix = bytes + framing_.header_offset;
+      uint64_t length = 0;
+      for (size_t i = 0; i < framing_.length_bytes; ++i) {
+        const size_t index =
+            framing_.big_endian ? i : framing_.length_bytes - 1 - i;
+        length = (length << 8) | prefix[index];
+      }
+      return SetMessageSize(header_size, length, expected);
+    }
+
+    case MessageFraming::Type::VARINT_PREFIX: {
+      uint64_t length = 0;
+      size_t i = framing_.header_offset;
+      for (int shift = 0;; shift += 7, ++i) {
+        if (i >= len) {
+          expected = i + 1;
+          return true;
+        }
+        if (shift >= 64) {
+          log().write(LogSeverity::Warning, "Invalid varint message length");
+          return false;
+        }
+        length |= uint64_t{bytes[i] & 0x7Fu} << shift;
+        if ((bytes[i] & 0x80) == 0)
+          break;
+      }
+      return SetMessageSize(i + 1, length, expected);
+    }
+
+    case MessageFraming::Type::FIXED_SIZE:
+      expected = framing_.record_size;
+      return true;
+  }
+
+  return false;
+}
+
+bool FramingMessageReader::SetMessageSize(size_t header_size,
+                                          uint64_t length,
+                                          size_t& expected) const {
+  if (header_size > framing_.max_message_size ||
+      length > framing_.max_message_size - header_size) {
+    log().write(LogSeverity::Warning,
+                "Message of {} bytes exceeds the maximum of {} bytes",
+                header_size + length, framing_.max_message_size);
+    return false;
+  }
+
+  expected = header_size + static_cast<size_t>(length);
+  cached_position_ = read_position();
+  cached_message_size_ = expected;
+  return true;
+}
+
+}  // namespace transport
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "transport/growable_message_reader.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace transport {
+
+// Built-in message framings.
+struct MessageFraming {
+  enum class Type {
+    // A fixed-width unsigned length of the payload.
+    LENGTH_PREFIX,
+    // A LEB128 varint length of the payload, as in Protocol Buffers.
+    VARINT_PREFIX,
+    // Records of `record_size` bytes.
+    FIXED_SIZE,
+  };
+
+  Type type = Type::LENGTH_PREFIX;
+  // The width of the length prefix, 2 or 4 bytes.
+  size_t length_bytes = 4;
+  bool big_endian = true;
+  // Bytes before the length prefix, such as a message type. The messages
+  // include them, as well as the prefix.
+  size_t header_offset = 0;
+  size_t record_size = 0;
+  // Larger messages fail the read. The length comes from the peer, so keep it
+  // as small as the protocol allows.
+  size_t max_message_size = 64 * 1024;
+};
+
+// Splits a stream into messages framed by `MessageFraming`. The size of a
+// partially received message is parsed once.
+class FramingMessageReader final : public GrowableMessageReader {
+ public:
+  FramingMessageReader(const MessageFraming& framing,
+                       std::shared_ptr<MessageBufferPool> pool);
+
+  const MessageFraming& framing() const { return framing_; }
+
+  // Returns false if the settings are out of range.
+  static bool IsValid(const MessageFraming& framing);
+
+  // MessageReader
+  [[nodiscard]] MessageReader* Clone() override;
+
+ protected:
+  // MessageReader
+  bool GetBytesExpected(const void* buf,
+                        size_t len,
+                        size_t& expected) const override;
+
+ private:
+  // Fails if the message is too large.
+  bool SetMessageSize(size_t header_size,
+                      uint64_t length,
+                      size_t& expected) const;
+
+  const MessageFraming framing_;
+
+  // The size of the message at `cached_position_`.
+  mutable uint64_t cached_position_ = 0;
+  mutable size_t cached_message_size_ = 0;
+};
+
+}  // namespace transport
@@ -0,0 +1,109 @@
+#include "transport/framing_message_reader.h"
+
+#include <gmock/gmock.h>
+#include <array>
+#include <vector>
+
+using namespace testing;
+
+namespace transport {
+namespace {
+
+FramingMessageReader MakeReader(const MessageFraming& framing) {
+  return FramingMessageReader{framing, std::make_shared<MessageBufferPool>()};
+}
+
+// Copies `data` into the reader as a single read.
+void Feed(MessageReader& reader, const std::vector<char>& data) {
+  auto buffer = reader.Prepare();
+  ASSERT_GE(buffer.size(), data.size());
+  std::ranges::copy(data, buffer.begin());
+  reader.BytesRead(data.size());
+}
+
+// Returns the error as a single `'!'`.
+std::vector<char> Pop(MessageReader& reader) {
+  std::array<char, 512> buffer;
+  auto bytes_popped = reader.Pop(buffer);
+  if (!bytes_popped.ok())
+    return {'!'};
+  return {buffer.begin(), buffer.begin() + *bytes_popped};
+}
+
+}  // namespace
+
+TEST(FramingMessageReaderTest, LengthPrefixesOfBothByteOrders) {
+  auto u16le = MakeReader({.length_bytes = 2,
+                           .big_endian = false,
+                           .header_offset = 1});
+  Feed(u16le, {7, 3, 0, 'a', 'b', 'c', 7});
+  EXPECT_THAT(Pop(u16le), ElementsAre(7, 3, 0, 'a', 'b', 'c'));
+  EXPECT_THAT(Pop(u16le), IsEmpty());
+
+  auto u32be = MakeReader({.length_bytes = 4, .big_endian = true});
+  Feed(u32be, {0, 0, 0, 2, 'x', 'y'});
+  EXPECT_THAT(Pop(u32be), ElementsAre(0, 0, 0, 2, 'x', 'y'));
+}
+
+TEST(FramingMessageReaderTest, VarintPrefixSpansBytes) {
+  auto reader = MakeReader({.type = MessageFraming::Type::VARINT_PREFIX});
+
+  // 300 in two bytes.
+  std::vector<char> message(2 + 300, 'v');
+  message[0] = static_cast<char>(0xAC);
+  message[1] = 0x02;
+
+  // The prefix itself arrives in parts.
+  Feed(reader, {message[0]});
+  EXPECT_THAT(Pop(reader), IsEmpty());
+  Feed(reader, {message.begin() + 1, message.end()});
+  EXPECT_EQ(Pop(reader), message);
+}
+
+TEST(FramingMessageReaderTest, FixedSizeRecords) {
+  auto reader = MakeReader(
+      {.type = MessageFraming::Type::FIXED_SIZE, .record_size = 3});
+
+  Feed(reader, {1, 2, 3, 4, 5, 6, 7});
+  EXPECT_THAT(Pop(reader), ElementsAre(1, 2, 3));
+  EXPECT_THAT(Pop(reader), ElementsAre(4, 5, 6));
+  EXPECT_THAT(Pop(reader), IsEmpty());
+}
+
+TEST(FramingMessageReaderTest, FailsOnMessageOverMaxSize) {
+  auto reader = MakeReader({.length_bytes = 2, .max_message_size = 100});
+
+  Feed(reader, {0, 99});
+  EXPECT_THAT(Pop(reader), ElementsAre('!'));
+}
+
+TEST(FramingMessageReaderTest, DefaultMaxSizeFailsOnLargeLength) {
+  auto reader = MakeReader({.length_bytes = 4, .big_endian = true});
+
+  // 64 KiB of payload after the prefix.
+  Feed(reader, {0, 1, 0, 0});
+  EXPECT_THAT(Pop(reader), ElementsAre('!'));
+}
+
+TEST(FramingMessageReaderTest, ParsedSizeDoesNotOutliveMessage) {
+  auto reader = MakeReader({.length_bytes = 2});
+
+  // The size is parsed once the prefix arrives and kept for the next reads.
+  Feed(reader, {0, 3, 'a', 'b'});
+  EXPECT_THAT(Pop(reader), IsEmpty());
+  Feed(reader, {'c'});
+  EXPECT_THAT(Pop(reader), ElementsAre(0, 3, 'a', 'b', 'c'));
+
+  // The next message starts at the same place of the buffer.
+  Feed(reader, {0, 1, 'z'});
+  EXPECT_THAT(Pop(reader), ElementsAre(0, 1, 'z'));
+}
+
+TEST(FramingMessageReaderTest, ValidatesSettings) {
+  EXPECT_TRUE(FramingMessageReader::IsValid({}));
+  EXPECT_FALSE(FramingMessageReader::IsValid({.length_bytes = 3}));
+  EXPECT_FALSE(FramingMessageReader::IsValid(
+      {.type = MessageFraming::Type::FIXED_SIZE}));
+}
+
+}  // namespace transport
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "transport/message_buffer_pool.h"
+#include "transport/message_reader.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+namespace transport {
+
+// A message reader starting with a small buffer and growing it on demand up to
+// `max_size`. Buffers come from a pool shared by the connections. A grown
+// buffer goes back to the pool once all the data is read, so memory follows
+// the actual traffic rather than the largest message.
+//
+// Subclasses parse the framing like with `MessageReaderImpl`, and pass the
+// pool and the limits on to their clones.
+class GrowableMessageReader : public MessageReader {
+ public:
+  GrowableMessageReader(std::shared_ptr<MessageBufferPool> pool,
+                        size_t initial_size,
+                        size_t max_size)
+      : MessageReader{nullptr, 0},
+        pool_{std::move(pool)},
+        initial_size_{initial_size},
+        max_size_{std::max(initial_size, max_size)} {
+    assert(pool_);
+    buffer_ = pool_->Acquire(initial_size_);
+    initial_capacity_ = buffer_.size;
+    SetBuffer(buffer_.data.get(), buffer_.size);
+  }
+
+  ~GrowableMessageReader() override { pool_->Release(std::move(buffer_)); }
+
+  const std::shared_ptr<MessageBufferPool>& pool() const { return pool_; }
+  size_t initial_size() const { return initial_size_; }
+  size_t max_size() const { return max_size_; }
+
+ protected:
+  // MessageReader
+  bool Reserve(size_t size) override {
+    if (size > max_size_)
+      return false;
+    if (size > capacity())
+      ReplaceBuffer(size);
+    return true;
+  }
+
+  void OnDrained() override {
+    if (capacity() > initial_capacity_)
+      ReplaceBuffer(initial_size_);
+  }
+
+ private:
+  void ReplaceBuffer(size_t size) {
+    auto buffer = pool_->Acquire(size);
+    SetBuffer(buffer.data.get(), buffer.size);
+    std::swap(buffer_, buffer);
+    pool_->Release(std::move(buffer));
+  }
+
+  const std::shared_ptr<MessageBufferPool> pool_;
+  const size_t initial_size_;
+  const size_t max_size_;
+  size_t initial_capacity_ = 0;
+  MessageBufferPool::Buffer buffer_;
+};
+
+}  // namespace transport
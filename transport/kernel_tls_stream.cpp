@@ -0,0 +1,161 @@
+#include "transport/kernel_tls_stream.h"
+
+#include <boost/asio/ssl/error.hpp>
+#include <boost/beast/core/error.hpp>
+#include <cerrno>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+namespace transport {
+
+namespace {
+
+// `SSL_get_error` relies on the error queue and `errno` being clean.
+void ClearErrors() {
+  ERR_clear_error();
+  errno = 0;
+}
+
+}  // namespace
+
+// KernelTlsStream::Impl
+
+KernelTlsStream::Impl::Impl(boost::asio::ip::tcp::socket socket,
+                            boost::asio::ssl::context& context)
+    : socket{std::move(socket)},
+      ssl{SSL_new(context.native_handle())},
+      deadline{this->socket.get_executor()} {
+  if (!ssl)
+    return;
+
+  boost::system::error_code ec;
+  this->socket.non_blocking(true, ec);
+  if (ec || !SSL_set_fd(ssl, static_cast<int>(this->socket.native_handle()))) {
+    SSL_free(ssl);
+    ssl = nullptr;
+    return;
+  }
+
+  SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+  SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+}
+
+KernelTlsStream::Impl::~Impl() {
+  if (ssl)
+    SSL_free(ssl);
+}
+
+void KernelTlsStream::Impl::SetHandshakeType(
+    boost::asio::ssl::stream_base::handshake_type type) {
+  if (!ssl)
+    return;
+
+  if (type == boost::asio::ssl::stream_base::client) {
+    SSL_set_connect_state(ssl);
+  } else {
+    SSL_set_accept_state(ssl);
+  }
+}
+
+std::optional<error_code> KernelTlsStream::Impl::GetError(
+    int result,
+    boost::asio::socket_base::wait_type& wait_type) {
+  switch (SSL_get_error(ssl, result)) {
+    case SSL_ERROR_WANT_READ:
+      wait_type = boost::asio::socket_base::wait_read;
+      return std::nullopt;
+
+    case SSL_ERROR_WANT_WRITE:
+      wait_type = boost::asio::socket_base::wait_write;
+      return std::nullopt;
+
+    case SSL_ERROR_ZERO_RETURN:
+      return boost::asio::error::eof;
+
+    case SSL_ERROR_SYSCALL:
+      if (errno != 0)
+        return error_code{errno, boost::system::system_category()};
+      return boost::asio::ssl::error::stream_truncated;
+
+    default: {
+      const auto error = ERR_get_error();
+      if (ERR_GET_REASON(error) == SSL_R_UNEXPECTED_EOF_WHILE_READING)
+        return boost::asio::ssl::error::stream_truncated;
+      return error_code{static_cast<int>(error),
+                        boost::asio::error::get_ssl_category()};
+    }
+  }
+}
+
+error_code KernelTlsStream::Impl::MapWaitError(error_code ec) const {
+  return timed_out ? error_code{boost::beast::error::timeout} : ec;
+}
+
+// KernelTlsStream calls
+
+int KernelTlsStream::HandshakeCall::operator()(SSL* ssl,
+                                               std::size_t&) const {
+  ClearErrors();
+  return SSL_do_handshake(ssl);
+}
+
+int KernelTlsStream::ReadCall::operator()(
+    SSL* ssl,
+    std::size_t& bytes_transferred) const {
+  ClearErrors();
+  return SSL_read_ex(ssl, buffer.data(), buffer.size(), &bytes_transferred);
+}
+
+int KernelTlsStream::WriteCall::operator()(
+    SSL* ssl,
+    std::size_t& bytes_transferred) const {
+  ClearErrors();
+  return SSL_write_ex(ssl, buffer.data(), buffer.size(), &bytes_transferred);
+}
+
+int KernelTlsStream::ShutdownCall::operator()(SSL* ssl, std::size_t&) const {
+  ClearErrors();
+  // Zero means the close notification is sent, but the peer's one is not
+  // received yet.
+  const int result = SSL_shutdown(ssl);
+  return result == 0 ? 1 : result;
+}
+
+// KernelTlsStream
+
+KernelTlsStream::KernelTlsStream(boost::asio::ip::tcp::socket socket,
+                                 boost::asio::ssl::context& context)
+    : impl_{std::make_shared<Impl>(std::move(socket), context)} {}
+
+bool KernelTlsStream::kernel_send() const {
+  return impl_->ssl && BIO_get_ktls_send(SSL_get_wbio(impl_->ssl));
+}
+
+bool KernelTlsStream::kernel_receive() const {
+  return impl_->ssl && BIO_get_ktls_recv(SSL_get_rbio(impl_->ssl));
+}
+
+void KernelTlsStream::expires_after(
+    std::chrono::steady_clock::duration expiry_time) {
+  impl_->deadline.expires_after(expiry_time);
+  impl_->deadline.async_wait(
+      [weak_impl = std::weak_ptr<Impl>{impl_}](error_code ec) {
+        auto impl = weak_impl.lock();
+        if (ec || !impl)
+          return;
+        impl->timed_out = true;
+        boost::system::error_code ignored;
+        impl->socket.cancel(ignored);
+      });
+}
+
+void KernelTlsStream::expires_never() {
+  impl_->deadline.cancel();
+}
+
+void KernelTlsStream::close(boost::system::error_code& ec) {
+  impl_->deadline.cancel();
+  impl_->socket.close(ec);
+}
+
+}  // namespace transport
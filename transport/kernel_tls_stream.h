@@ -0,0 +1,253 @@
+#pragma once
+
+#include "transport/error.h"
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream_base.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/role.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+typedef struct ssl_st SSL;
+
+namespace transport {
+
+// A TLS stream that lets OpenSSL drive the socket itself, instead of passing
+// records through memory buffers like `boost::asio::ssl::stream` does. This
+// lets OpenSSL install the negotiated keys into the kernel (kTLS) after the
+// handshake, so that reads and writes pass plaintext to the socket and the
+// kernel does the record crypto. The directions the kernel or the cipher
+// don't support keep the user-space crypto.
+//
+// Follows the timeout interface of `boost::beast::tcp_stream`.
+class KernelTlsStream {
+ public:
+  using executor_type = boost::asio::any_io_executor;
+
+  // `socket` must be connected.
+  KernelTlsStream(boost::asio::ip::tcp::socket socket,
+                  boost::asio::ssl::context& context);
+
+  KernelTlsStream(KernelTlsStream&&) = default;
+  KernelTlsStream& operator=(KernelTlsStream&&) = default;
+
+  executor_type get_executor() noexcept { return impl_->socket.get_executor(); }
+
+  // Null if OpenSSL failed to create the connection.
+  SSL* native_handle() { return impl_->ssl; }
+
+  boost::asio::ip::tcp::socket& socket() { return impl_->socket; }
+
+  // Whether the kernel encrypts the outgoing or decrypts the incoming
+  // records. Known once the handshake completes.
+  [[nodiscard]] bool kernel_send() const;
+  [[nodiscard]] bool kernel_receive() const;
+
+  // Pending and following operations fail with `boost::beast::error::timeout`
+  // once the time is out.
+  void expires_after(std::chrono::steady_clock::duration expiry_time);
+  void expires_never();
+
+  void close(boost::system::error_code& ec);
+
+  template <typename HandshakeToken>
+  auto async_handshake(boost::asio::ssl::stream_base::handshake_type type,
+                       HandshakeToken&& token) {
+    impl_->SetHandshakeType(type);
+    return boost::asio::async_compose<HandshakeToken, void(error_code)>(
+        IoOp<HandshakeCall>{impl_}, token, impl_->socket);
+  }
+
+  template <typename MutableBufferSequence, typename ReadToken>
+  auto async_read_some(const MutableBufferSequence& buffers,
+                       ReadToken&& token) {
+    return boost::asio::async_compose<ReadToken,
+                                      void(error_code, std::size_t)>(
+        IoOp<ReadCall>{impl_,
+                       {FirstBuffer<boost::asio::mutable_buffer>(buffers)}},
+        token, impl_->socket);
+  }
+
+  template <typename ConstBufferSequence, typename WriteToken>
+  auto async_write_some(const ConstBufferSequence& buffers,
+                        WriteToken&& token) {
+    return boost::asio::async_compose<WriteToken,
+                                      void(error_code, std::size_t)>(
+        IoOp<WriteCall>{impl_,
+                        {FirstBuffer<boost::asio::const_buffer>(buffers)}},
+        token, impl_->socket);
+  }
+
+  // Sends the close notification. Doesn't wait for the peer's one.
+  template <typename ShutdownToken>
+  auto async_shutdown(ShutdownToken&& token) {
+    return boost::asio::async_compose<ShutdownToken, void(error_code)>(
+        IoOp<ShutdownCall>{impl_}, token, impl_->socket);
+  }
+
+ private:
+  struct Impl {
+    Impl(boost::asio::ip::tcp::socket socket,
+         boost::asio::ssl::context& context);
+    ~Impl();
+
+    void SetHandshakeType(boost::asio::ssl::stream_base::handshake_type type);
+
+    // Makes the error of a failed OpenSSL call returning `result`. Returns
+    // nothing if the call has to wait for the socket to be readable or
+    // writable, in which case `wait_type` is set.
+    std::optional<error_code> GetError(
+        int result,
+        boost::asio::socket_base::wait_type& wait_type);
+
+    error_code MapWaitError(error_code ec) const;
+
+    boost::asio::ip::tcp::socket socket;
+    SSL* ssl = nullptr;
+    boost::asio::steady_timer deadline;
+    bool timed_out = false;
+  };
+
+  // OpenSSL calls. Return the OpenSSL result.
+  struct HandshakeCall {
+    int operator()(SSL* ssl, std::size_t& bytes_transferred) const;
+  };
+  struct ReadCall {
+    boost::asio::mutable_buffer buffer;
+    int operator()(SSL* ssl, std::size_t& bytes_transferred) const;
+  };
+  struct WriteCall {
+    boost::asio::const_buffer buffer;
+    int operator()(SSL* ssl, std::size_t& bytes_transferred) const;
+  };
+  struct ShutdownCall {
+    int operator()(SSL* ssl, std::size_t& bytes_transferred) const;
+  };
+
+  // Repeats `Call` until it succeeds or fails, waiting for the socket between
+  // attempts.
+  template <typename Call>
+  struct IoOp {
+    std::shared_ptr<Impl> impl;
+    Call call = {};
+    bool started = false;
+    bool completing = false;
+    error_code result = {};
+    std::size_t bytes_transferred = 0;
+
+    template <typename Self>
+    void operator()(Self& self, error_code ec = {}) {
+      if (completing) {
+        Complete(self);
+        return;
+      }
+
+      if (ec || impl->timed_out) {
+        result = impl->MapWaitError(ec);
+        Finish(self);
+        return;
+      }
+
+      if (!impl->ssl) {
+        result = ERR_FAILED;
+        Finish(self);
+        return;
+      }
+
+      if constexpr (requires { call.buffer; }) {
+        if (call.buffer.size() == 0) {
+          Finish(self);
+          return;
+        }
+      }
+
+      const int ssl_result = call(impl->ssl, bytes_transferred);
+      if (ssl_result == 1) {
+        Finish(self);
+        return;
+      }
+
+      boost::asio::socket_base::wait_type wait_type;
+      if (auto error = impl->GetError(ssl_result, wait_type)) {
+        result = *error;
+        Finish(self);
+        return;
+      }
+
+      started = true;
+      impl->socket.async_wait(wait_type, std::move(self));
+    }
+
+    // Doesn't complete from the initiating function.
+    template <typename Self>
+    void Finish(Self& self) {
+      if (!started) {
+        started = true;
+        completing = true;
+        boost::asio::post(impl->socket.get_executor(), std::move(self));
+        return;
+      }
+      Complete(self);
+    }
+
+    template <typename Self>
+    void Complete(Self& self) {
+      if constexpr (requires { call.buffer; }) {
+        self.complete(result, bytes_transferred);
+      } else {
+        self.complete(result);
+      }
+    }
+  };
+
+  // OpenSSL has no scatter-gather I/O, so the operations transfer the first
+  // non-empty buffer, like `boost::asio::ssl::stream` does.
+  template <typename Buffer, typename BufferSequence>
+  static Buffer FirstBuffer(const BufferSequence& buffers) {
+    for (auto i = boost::asio::buffer_sequence_begin(buffers);
+         i != boost::asio::buffer_sequence_end(buffers); ++i) {
+      Buffer buffer{*i};
+      if (buffer.size() != 0)
+        return buffer;
+    }
+    return {};
+  }
+
+  std::shared_ptr<Impl> impl_;
+};
+
+// Lets Beast close the stream on timeouts.
+inline void beast_close_socket(KernelTlsStream& stream) {
+  boost::system::error_code ignored;
+  stream.close(ignored);
+}
+
+// Lets `boost::beast::websocket::stream` close the stream.
+template <typename TeardownHandler>
+void async_teardown(boost::beast::role_type,
+                    KernelTlsStream& stream,
+                    TeardownHandler&& handler) {
+  auto executor =
+      boost::asio::get_associated_executor(handler, stream.get_executor());
+  stream.async_shutdown(boost::asio::bind_executor(
+      executor, [&stream, handler = std::forward<TeardownHandler>(handler)](
+                    error_code ec) mutable {
+        boost::system::error_code ignored;
+        stream.close(ignored);
+        handler(ec);
+      }));
+}
+
+}  // namespace transport
@@ -0,0 +1,64 @@
+#include "transport/message_buffer_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace transport {
+
+MessageBufferPool::MessageBufferPool(const Options& options)
+    : options_{options} {
+  assert(options_.min_size != 0);
+}
+
+size_t MessageBufferPool::GetSizeClass(size_t size) const {
+  const size_t min_size = std::bit_ceil(options_.min_size);
+  size = std::max(size, min_size);
+  return std::bit_width(std::bit_ceil(size)) - std::bit_width(min_size);
+}
+
+MessageBufferPool::Buffer MessageBufferPool::Acquire(size_t size) {
+  const size_t size_class = GetSizeClass(size);
+  const size_t class_size = std::bit_ceil(options_.min_size) << size_class;
+
+  {
+    std::lock_guard lock{mutex_};
+    if (size_class < free_buffers_.size() &&
+        !free_buffers_[size_class].empty()) {
+      auto& free_buffers = free_buffers_[size_class];
+      Buffer buffer{std::move(free_buffers.back()), class_size};
+      free_buffers.pop_back();
+      free_bytes_ -= class_size;
+      return buffer;
+    }
+  }
+
+  return Buffer{std::make_unique_for_overwrite<char[]>(class_size),
+                class_size};
+}
+
+void MessageBufferPool::Release(Buffer buffer) {
+  if (!buffer.data)
+    return;
+
+  const size_t size_class = GetSizeClass(buffer.size);
+  // Buffers not handed out by the pool are dropped.
+  if ((std::bit_ceil(options_.min_size) << size_class) != buffer.size)
+    return;
+
+  std::lock_guard lock{mutex_};
+  if (free_bytes_ + buffer.size > options_.max_free_bytes)
+    return;
+
+  if (free_buffers_.size() <= size_class)
+    free_buffers_.resize(size_class + 1);
+  free_buffers_[size_class].push_back(std::move(buffer.data));
+  free_bytes_ += buffer.size;
+}
+
+size_t MessageBufferPool::free_bytes() const {
+  std::lock_guard lock{mutex_};
+  return free_bytes_;
+}
+
+}  // namespace transport
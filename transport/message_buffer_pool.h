@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace transport {
+
+// Hands out message buffers in power-of-two size classes and keeps the
+// released ones for reuse, so that connections take memory for large messages
+// only while they read them. Thread-safe, so it can be shared by connections
+// running on different threads.
+class MessageBufferPool {
+ public:
+  struct Options {
+    // The smallest size class.
+    size_t min_size = 256;
+    // Released buffers past this total are freed.
+    size_t max_free_bytes = 16 * 1024 * 1024;
+  };
+
+  struct Buffer {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+
+  MessageBufferPool() : MessageBufferPool{Options{}} {}
+  explicit MessageBufferPool(const Options& options);
+
+  MessageBufferPool(const MessageBufferPool&) = delete;
+  MessageBufferPool& operator=(const MessageBufferPool&) = delete;
+
+  // Returns a buffer of the size class fitting `size`.
+  [[nodiscard]] Buffer Acquire(size_t size);
+  void Release(Buffer buffer);
+
+  // Released buffers kept for reuse.
+  size_t free_bytes() const;
+
+ private:
+  size_t GetSizeClass(size_t size) const;
+
+  const Options options_;
+
+  mutable std::mutex mutex_;
+  // Indexed by the size class.
+  std::vector<std::vector<std::unique_ptr<char[]>>> free_buffers_;
+  size_t free_bytes_ = 0;
+};
+
+}  // namespace transport
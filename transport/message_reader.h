@@ -4,8 +4,12 @@
 #include "transport/expected.h"
 #include "transport/log.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <span>
+#include <stdexcept>
 
 namespace transport {
 
@@ -22,17 +26,25 @@ namespace transport {
 //    }
 //
 //    if (my_reader.complete()) {
-//       ByteMessage& msg = my_reader.message();
+//       ByteMessage msg = my_reader.message();
 //       ...
 //       my_reader.Reset();
 //    }
 //
 // Don't forget to reset buffer on read error.
+//
+// The unread data lies between the read and the write offsets of the buffer.
+// Popping a message advances the read offset, so many messages arriving in a
+// single read are popped without moving the rest. The unread data is moved to
+// the front only when no space is left after it.
 
 class MessageReader {
  public:
   MessageReader(void* buffer, size_t capacity)
-      : buffer_(buffer, capacity), complete_(false), error_correction_(false) {}
+      : data_(static_cast<char*>(buffer)),
+        capacity_(capacity),
+        complete_(false),
+        error_correction_(false) {}
   virtual ~MessageReader() {}
 
   MessageReader(const MessageReader&) = delete;
@@ -41,78 +53,109 @@ class MessageReader {
   // Did message completely read.
   bool complete() const { return complete_; }
   // Get current message.
-  const ByteMessage& message() const { return buffer_; }
+  ByteMessage message() const {
+    return ByteMessage(data_ + begin_, end_ - begin_, end_ - begin_);
+  }
   // Get read position.
-  void* ptr() { return buffer_.ptr(); }
+  void* ptr() { return data_ + end_; }
+  size_t capacity() const { return capacity_; }
 
   std::span<char> Alloc(size_t size) {
-    assert(size <= buffer_.max_read());
-    return std::span<char>{reinterpret_cast<char*>(buffer_.ptr()),
-                           reinterpret_cast<char*>(buffer_.ptr()) + size};
+    assert(size <= capacity_ - end_);
+    return std::span<char>{data_ + end_, size};
   }
 
   std::span<char> Prepare() {
-    assert(buffer_.max_write() != 0);
+    if (end_ == capacity_)
+      Compact();
+
+    assert(end_ != capacity_);
 
-    return std::span<char>{
-        reinterpret_cast<char*>(buffer_.ptr()),
-        reinterpret_cast<char*>(buffer_.ptr()) + buffer_.max_write()};
+    return std::span<char>{data_ + end_, capacity_ - end_};
   }
 
-  // Returns an empty span if there is no data to pop.
+  // Returns an empty span if there is no data to pop. A message larger than
+  // `data` is dropped with `ERR_INVALID_ARGUMENT`, so the next pop starts at
+  // the next message.
   expected<size_t> Pop(std::span<char> data) {
     size_t bytes_expected = 0;
-    if (!GetBytesExpected(buffer_.data, buffer_.size, bytes_expected)) {
+    if (!GetBytesExpected(data_ + begin_, end_ - begin_, bytes_expected)) {
       return ERR_FAILED;
     }
 
-    if (bytes_expected > buffer_.size) {
+    if (bytes_expected > end_ - begin_) {
+      if (bytes_expected > capacity_ && !Reserve(bytes_expected)) {
+        log_.write(LogSeverity::Warning,
+                   "Message of {} bytes doesn't fit the buffer",
+                   bytes_expected);
+        return ERR_FAILED;
+      }
       return 0;
     }
 
-    std::copy_n(buffer_.data, bytes_expected, data.data());
-    buffer_.Pop(bytes_expected);
+    if (bytes_expected > data.size()) {
+      log_.write(LogSeverity::Warning,
+                 "Message of {} bytes doesn't fit the read buffer of {} bytes",
+                 bytes_expected, data.size());
+      Consume(bytes_expected);
+      return ERR_INVALID_ARGUMENT;
+    }
+
+    std::copy_n(data_ + begin_, bytes_expected, data.data());
+    Consume(bytes_expected);
     return bytes_expected;
   }
 
-  bool IsEmpty() const { return buffer_.empty(); }
+  bool IsEmpty() const { return begin_ == end_; }
 
   bool has_error_correction() const { return error_correction_; }
   void set_error_correction(bool correction) { error_correction_ = correction; }
 
   void set_log(const log_source& log) { log_ = log; }
 
-  bool TryCorrectError() { return error_correction_ && SkipFirstByte(); }
+  // Drops the data up to where the next message may start.
+  bool TryCorrectError() {
+    if (!error_correction_ || begin_ == end_)
+      return false;
+    const size_t size = end_ - begin_;
+    Consume(std::clamp<size_t>(GetBytesToSkip(data_ + begin_, size), 1, size));
+    return true;
+  }
 
   // Number of bytes to pass for next read operation.
   bool GetBytesToRead(size_t& bytes_to_read) const {
     size_t expected = 0;
-    if (!GetBytesExpected(buffer_.data, buffer_.size, expected))
+    const size_t size = end_ - begin_;
+    if (!GetBytesExpected(data_ + begin_, size, expected))
       return false;
     assert(expected > 0);
-    assert(expected <= buffer_.capacity);
-    assert(buffer_.size <= expected);
-    bytes_to_read = expected - buffer_.size;
+    assert(expected <= capacity_);
+    assert(size <= expected);
+    bytes_to_read = expected - size;
     complete_ = bytes_to_read == 0;
     return true;
   }
 
   // Skip read bytes.
-  void BytesRead(size_t count) { buffer_.Write(nullptr, count); }
+  void BytesRead(size_t count) {
+    if (count > capacity_ - end_)
+      throw std::runtime_error("Write error");
+    end_ += count;
+  }
 
   // Reset buffer.
   void Reset() {
-    buffer_.Clear();
+    read_position_ += end_ - begin_;
+    begin_ = 0;
+    end_ = 0;
     complete_ = false;
+    OnReset();
   }
 
   bool SkipFirstByte() {
-    if (buffer_.size == 0)
+    if (begin_ == end_)
       return false;
-    if (buffer_.size >= 2)
-      memmove(buffer_.data, buffer_.data + 1, buffer_.size - 1);
-    buffer_.size--;
-    buffer_.pos = 0;
+    Consume(1);
     return true;
   }
 
@@ -128,8 +171,62 @@ class MessageReader {
 
   const log_source& log() const { return log_; }
 
+  // The position of the unread data in the stream. Identifies the message at
+  // the front across buffer moves, e.g. to cache its parsed header.
+  uint64_t read_position() const { return read_position_; }
+
+  // Returns the number of bytes to drop on an invalid message. Framings with
+  // markers can skip straight to the next one.
+  virtual size_t GetBytesToSkip(const void* buf, size_t len) const {
+    return 1;
+  }
+
+  // Called when a message doesn't fit the buffer. Returns false if the buffer
+  // can't hold `size` bytes.
+  virtual bool Reserve(size_t size) { return false; }
+  // Called once all the data is read.
+  virtual void OnDrained() {}
+  // Called when the unread data is dropped by `Reset`.
+  virtual void OnReset() {}
+
+  // Moves the unread data to the front of `buffer`, which must fit it.
+  void SetBuffer(void* buffer, size_t capacity) {
+    assert(end_ - begin_ <= capacity);
+    if (begin_ != end_)
+      memmove(buffer, data_ + begin_, end_ - begin_);
+    data_ = static_cast<char*>(buffer);
+    capacity_ = capacity;
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
  private:
-  ByteMessage buffer_;
+  void Consume(size_t count) {
+    begin_ += count;
+    read_position_ += count;
+    // Rewinds for free once all is read.
+    if (begin_ == end_) {
+      begin_ = 0;
+      end_ = 0;
+      OnDrained();
+    }
+  }
+
+  // Moves the unread data to the front of the buffer.
+  void Compact() {
+    if (begin_ == 0)
+      return;
+    memmove(data_, data_ + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
+  char* data_;
+  size_t capacity_;
+  // The unread data.
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  uint64_t read_position_ = 0;
   mutable bool complete_;
   log_source log_;
   bool error_correction_;
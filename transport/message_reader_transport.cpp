@@ -147,10 +147,19 @@ awaitable<expected<size_t>> MessageReaderTransport::Core::ReadMessage(
   for (;;) {
     auto bytes_popped = message_reader_->Pop(buffer);
 
+    // The message was dropped, the data after it is still in sync.
+    if (bytes_popped == ERR_INVALID_ARGUMENT) {
+      co_return bytes_popped;
+    }
+
     if (!bytes_popped.ok()) {
       // TODO: Add UT.
       // TODO: Print message.
       log_.write(LogSeverity::Warning, "Invalid message");
+      // Resynchronizes on the data left, if the reader corrects errors.
+      if (message_reader_->TryCorrectError()) {
+        continue;
+      }
       co_return bytes_popped;
     }
 
@@ -195,6 +204,13 @@ awaitable<expected<size_t>> MessageReaderTransport::Core::WriteMessage(
   co_return co_await child_transport_.write(std::move(data));
 }
 
+// Messages popped from data read earlier report the time of the last child
+// read.
+std::optional<ReceiveTimestamp> MessageReaderTransport::last_receive_timestamp()
+    const {
+  return core_->child_transport_.last_receive_timestamp();
+}
+
 std::string MessageReaderTransport::name() const {
   return "MSG:" + core_->child_transport_.name();
 }
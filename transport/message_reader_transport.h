@@ -39,6 +39,8 @@ class MessageReaderTransport final : public Transport {
   [[nodiscard]] virtual awaitable<expected<size_t>> write(
       std::span<const char> data) override;
 
+  virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const override;
   virtual std::string name() const override;
   virtual bool message_oriented() const override;
   virtual bool connected() const override;
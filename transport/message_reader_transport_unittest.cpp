@@ -135,6 +135,24 @@ TEST_F(MessageReaderTransportTest, CompositeMessage_LongerSize) {
   });
 }
 
+TEST_F(MessageReaderTransportTest, SkipsMessageNotFittingReadBuffer) {
+  CoTest([&]() -> awaitable<void> {
+    CreateMessageReaderTransport(/*message_oriented=*/true);
+    co_await message_reader_transport_->open();
+
+    // The first message doesn't fit the 100-byte buffer of `ReadMessage`.
+    std::vector<char> composite(101, 0);
+    composite[0] = 100;
+    composite.insert(composite.end(), {1, 0});
+    ExpectChildReadMessage(composite);
+
+    const auto message2 = std::vector<char>{1, 0};
+
+    EXPECT_EQ(co_await ReadMessage(), ERR_INVALID_ARGUMENT);
+    EXPECT_EQ(co_await ReadMessage(), message2);
+  });
+}
+
 TEST_F(MessageReaderTransportTest, CompositeMessage_DestroyInTheMiddle) {
   CoTest([&]() -> awaitable<void> {
     CreateMessageReaderTransport(/*message_oriented=*/true);
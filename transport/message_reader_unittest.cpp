@@ -0,0 +1,212 @@
+#include "transport/message_reader.h"
+
+#include "transport/growable_message_reader.h"
+#include "transport/test/test_message_reader.h"
+
+#include <gmock/gmock.h>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace testing;
+
+namespace transport {
+namespace {
+
+// Like `TestMessageReader`, with room for large reads.
+class LargeTestMessageReader : public MessageReaderImpl<64 * 1024> {
+ public:
+  MessageReader* Clone() override { return new LargeTestMessageReader(); }
+
+ protected:
+  bool GetBytesExpected(const void* buf,
+                        size_t len,
+                        size_t& expected) const override {
+    const auto* bytes = static_cast<const uint8_t*>(buf);
+    expected = len < 1 ? 1 : 1 + static_cast<size_t>(bytes[0]);
+    return true;
+  }
+};
+
+// Uses the first two bytes as the little-endian message size.
+class GrowableTestMessageReader : public GrowableMessageReader {
+ public:
+  using GrowableMessageReader::GrowableMessageReader;
+
+  MessageReader* Clone() override {
+    return new GrowableTestMessageReader(pool(), initial_size(), max_size());
+  }
+
+ protected:
+  bool GetBytesExpected(const void* buf,
+                        size_t len,
+                        size_t& expected) const override {
+    const auto* bytes = static_cast<const uint8_t*>(buf);
+    expected = len < 2 ? 2 : 2 + (bytes[0] | (size_t{bytes[1]} << 8));
+    return true;
+  }
+};
+
+// Copies `data` into the reader as a single read.
+void Feed(MessageReader& reader, const std::vector<char>& data) {
+  auto buffer = reader.Prepare();
+  ASSERT_GE(buffer.size(), data.size());
+  std::ranges::copy(data, buffer.begin());
+  reader.BytesRead(data.size());
+}
+
+std::vector<char> Pop(MessageReader& reader) {
+  std::array<char, 512> buffer;
+  auto bytes_popped = reader.Pop(buffer);
+  EXPECT_TRUE(bytes_popped.ok());
+  return bytes_popped.ok() ? std::vector<char>(buffer.begin(),
+                                               buffer.begin() + *bytes_popped)
+                           : std::vector<char>{};
+}
+
+}  // namespace
+
+TEST(MessageReaderTest, PopsMessagesOfSingleRead) {
+  TestMessageReader reader;
+  Feed(reader, {1, 'a', 2, 'b', 'c', 0, 2, 'd'});
+
+  EXPECT_THAT(Pop(reader), ElementsAre(1, 'a'));
+  EXPECT_THAT(Pop(reader), ElementsAre(2, 'b', 'c'));
+  EXPECT_THAT(Pop(reader), ElementsAre(0));
+  // The last message is partial.
+  EXPECT_THAT(Pop(reader), IsEmpty());
+  EXPECT_FALSE(reader.IsEmpty());
+
+  Feed(reader, {'e'});
+  EXPECT_THAT(Pop(reader), ElementsAre(2, 'd', 'e'));
+  EXPECT_TRUE(reader.IsEmpty());
+  // The whole buffer is available again.
+  EXPECT_EQ(reader.Prepare().size(), 1024u);
+}
+
+TEST(MessageReaderTest, CompactsPartialMessageOnceBufferIsFull) {
+  TestMessageReader reader;
+
+  // 102 messages of 10 bytes, then 4 bytes of another one.
+  std::vector<char> data;
+  for (int i = 0; i < 103; ++i) {
+    data.push_back(9);
+    for (char c = 0; c < 9; ++c)
+      data.push_back(static_cast<char>(i + c));
+  }
+  data.resize(1024);
+  Feed(reader, data);
+
+  for (int i = 0; i < 102; ++i)
+    EXPECT_EQ(Pop(reader).size(), 10u);
+  EXPECT_THAT(Pop(reader), IsEmpty());
+
+  // The partial message moves to the front.
+  EXPECT_EQ(reader.Prepare().size(), 1024u - 4);
+  Feed(reader, {105, 106, 107, 108, 109, 110});
+  EXPECT_THAT(Pop(reader),
+              ElementsAre(9, 102, 103, 104, 105, 106, 107, 108, 109, 110));
+  EXPECT_TRUE(reader.IsEmpty());
+}
+
+TEST(MessageReaderTest, SkipFirstByteDropsOneByte) {
+  TestMessageReader reader;
+  Feed(reader, {5, 1, 'a'});
+
+  EXPECT_TRUE(reader.SkipFirstByte());
+  EXPECT_THAT(Pop(reader), ElementsAre(1, 'a'));
+  EXPECT_FALSE(reader.SkipFirstByte());
+}
+
+TEST(MessageReaderTest, DropsMessageNotFittingPopBuffer) {
+  TestMessageReader reader;
+  Feed(reader, {3, 'a', 'b', 'c', 1, 'd'});
+
+  std::array<char, 2> buffer;
+  EXPECT_EQ(reader.Pop(buffer), ERR_INVALID_ARGUMENT);
+  // The next message is still in sync.
+  EXPECT_THAT(Pop(reader), ElementsAre(1, 'd'));
+  EXPECT_TRUE(reader.IsEmpty());
+}
+
+TEST(GrowableMessageReaderTest, GrowsForLargeMessageAndShrinksOnceDrained) {
+  auto pool = std::make_shared<MessageBufferPool>(
+      MessageBufferPool::Options{.min_size = 16});
+  GrowableTestMessageReader reader{pool, /*initial_size=*/16,
+                                   /*max_size=*/1024};
+  EXPECT_EQ(reader.capacity(), 16u);
+
+  std::vector<char> message(2 + 300, 'x');
+  message[0] = 300 & 0xFF;
+  message[1] = 300 >> 8;
+
+  Feed(reader, {message.begin(), message.begin() + 10});
+  EXPECT_THAT(Pop(reader), IsEmpty());
+  EXPECT_EQ(reader.capacity(), 512u);
+  // The initial buffer is back in the pool.
+  EXPECT_EQ(pool->free_bytes(), 16u);
+
+  Feed(reader, {message.begin() + 10, message.end()});
+  EXPECT_EQ(Pop(reader), message);
+  EXPECT_EQ(reader.capacity(), 16u);
+  EXPECT_EQ(pool->free_bytes(), 512u);
+
+  // Another connection reuses the grown buffer.
+  std::unique_ptr<MessageReader> clone{reader.Clone()};
+  Feed(*clone, {message.begin(), message.begin() + 2});
+  EXPECT_THAT(Pop(*clone), IsEmpty());
+  EXPECT_EQ(clone->capacity(), 512u);
+  EXPECT_EQ(pool->free_bytes(), 16u);
+}
+
+TEST(GrowableMessageReaderTest, FailsOnMessageOverMaxSize) {
+  auto pool = std::make_shared<MessageBufferPool>();
+  GrowableTestMessageReader reader{pool, /*initial_size=*/256,
+                                   /*max_size=*/1024};
+
+  Feed(reader, {0x01, 0x04});
+  std::array<char, 16> buffer;
+  EXPECT_FALSE(reader.Pop(buffer).ok());
+}
+
+// Pops about 10k small frames per 64 KB read.
+TEST(MessageReaderTest, DISABLED_PopSmallFramesBenchmark) {
+  constexpr size_t kFrameSize = 6;
+  constexpr int kReadCount = 2000;
+
+  // Frames don't align with reads, so the last one of each read is partial.
+  std::vector<char> stream(64 * 1024 + kFrameSize);
+  for (size_t i = 0; i < stream.size(); i += kFrameSize)
+    stream[i] = static_cast<char>(kFrameSize - 1);
+
+  LargeTestMessageReader reader;
+  std::array<char, kFrameSize> message;
+  size_t offset = 0;
+  size_t message_count = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kReadCount; ++i) {
+    auto buffer = reader.Prepare();
+    // Continues the frame sequence where the previous read stopped.
+    std::copy_n(stream.begin() + offset, buffer.size(), buffer.begin());
+    offset = (offset + buffer.size()) % kFrameSize;
+    reader.BytesRead(buffer.size());
+
+    for (;;) {
+      auto bytes_popped = reader.Pop(message);
+      ASSERT_TRUE(bytes_popped.ok());
+      if (*bytes_popped == 0)
+        break;
+      ++message_count;
+    }
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "Frames per read: " << message_count / kReadCount
+            << ", frames per second: " << message_count / elapsed.count()
+            << std::endl;
+}
+
+}  // namespace transport
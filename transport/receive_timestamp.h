@@ -0,0 +1,47 @@
+#pragma once
+
+#include "transport/transport.h"
+
+#include <chrono>
+#include <cstring>
+#include <optional>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <time.h>
+#endif
+
+namespace transport {
+
+#if defined(__linux__)
+
+// The control message space `recvmsg` needs for a receive timestamp.
+inline constexpr size_t kReceiveTimestampControlSize =
+    CMSG_SPACE(sizeof(timespec));
+
+// Asks the kernel to attach a receive timestamp to each read. Returns false if
+// the socket doesn't support it.
+inline bool EnableReceiveTimestamps(int socket) {
+  int enable = 1;
+  return ::setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable,
+                      sizeof(enable)) == 0;
+}
+
+// Returns nothing if the control message is not a receive timestamp.
+inline std::optional<ReceiveTimestamp> GetReceiveTimestamp(
+    const cmsghdr& header) {
+  if (header.cmsg_level != SOL_SOCKET || header.cmsg_type != SCM_TIMESTAMPNS) {
+    return std::nullopt;
+  }
+
+  timespec time = {};
+  std::memcpy(&time, CMSG_DATA(&header), sizeof(time));
+  const auto since_epoch =
+      std::chrono::seconds{time.tv_sec} + std::chrono::nanoseconds{time.tv_nsec};
+  return ReceiveTimestamp{
+      std::chrono::duration_cast<ReceiveTimestamp::duration>(since_epoch)};
+}
+
+#endif  // defined(__linux__)
+
+}  // namespace transport
@@ -2,11 +2,29 @@
 
 #include "transport/any_transport.h"
 #include "transport/log.h"
+#include "transport/receive_timestamp.h"
+#include "transport/tls_transport.h"
 
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/connect.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <cerrno>
+#include <exception>
+#include <list>
+#include <queue>
 
 namespace transport {
 
+namespace {
+
+constexpr std::chrono::seconds kTlsHandshakeTimeout{10};
+
+}  // namespace
+
 // ActiveTcpTransport
 
 ActiveTcpTransport::ActiveTcpTransport(
@@ -32,6 +50,8 @@ ActiveTcpTransport::ActiveTcpTransport(
       source_location_{source_location} {
   io_object_ = std::move(socket);
   connected_ = true;
+
+  EnableReceiveTimestamps();
 }
 
 ActiveTcpTransport::~ActiveTcpTransport() {
@@ -114,9 +134,79 @@ awaitable<error_code> ActiveTcpTransport::Connect(
 
   connected_ = true;
 
+  EnableReceiveTimestamps();
+
   co_return OK;
 }
 
+void ActiveTcpTransport::EnableReceiveTimestamps() {
+#if defined(__linux__)
+  timestamps_enabled_ =
+      transport::EnableReceiveTimestamps(io_object_.native_handle());
+#endif
+}
+
+awaitable<expected<size_t>> ActiveTcpTransport::read(std::span<char> data) {
+#if defined(__linux__)
+  if (timestamps_enabled_ && !closed_) {
+    for (;;) {
+      auto bytes_read = ReadMessage(data);
+      if (bytes_read.error() != boost::asio::error::would_block) {
+        co_return bytes_read;
+      }
+
+      auto [error] = co_await io_object_.async_wait(
+          Socket::wait_read, boost::asio::as_tuple(boost::asio::use_awaitable));
+
+      if (closed_) {
+        co_return ERR_CONNECTION_CLOSED;
+      }
+
+      if (error) {
+        co_return error;
+      }
+    }
+  }
+#endif
+
+  co_return co_await AsioTransport::read(data);
+}
+
+#if defined(__linux__)
+
+expected<size_t> ActiveTcpTransport::ReadMessage(std::span<char> data) {
+  iovec iov = {data.data(), data.size()};
+  alignas(cmsghdr) char control[kReceiveTimestampControlSize] = {};
+
+  msghdr message = {};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  auto result = ::recvmsg(io_object_.native_handle(), &message, MSG_DONTWAIT);
+  if (result < 0) {
+    return error_code{errno, boost::asio::error::get_system_category()};
+  }
+
+  // Match `async_read_some`, which reports a graceful close as an error.
+  if (result == 0 && !data.empty()) {
+    return boost::asio::error::eof;
+  }
+
+  // The timestamp of the last segment the data comes from.
+  for (auto* header = CMSG_FIRSTHDR(&message); header;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (auto timestamp = GetReceiveTimestamp(*header)) {
+      last_receive_timestamp_ = timestamp;
+    }
+  }
+
+  return static_cast<size_t>(result);
+}
+
+#endif  // defined(__linux__)
+
 void ActiveTcpTransport::Cleanup() {
   assert(closed_);
 
@@ -133,18 +223,59 @@ void ActiveTcpTransport::Cleanup() {
 
 // PassiveTcpTransport
 
-PassiveTcpTransport::PassiveTcpTransport(const executor& executor,
-                                         const log_source& log,
-                                         const std::string& host,
-                                         const std::string& service)
+// The state of the TLS accept loop and of the handshakes it starts, which
+// don't refer to the transport.
+struct PassiveTcpTransport::TlsHandshakes {
+  TlsHandshakes(const executor& executor,
+                std::shared_ptr<boost::asio::ssl::context> context,
+                const log_source& log)
+      : context{std::move(context)},
+        log{log},
+        accepted_timer{executor,
+                       boost::asio::steady_timer::time_point::max()} {}
+
+  // Cancels the pending handshakes and drops the completed ones.
+  void Close() {
+    closed = true;
+    for (auto& cancellation : cancellations)
+      cancellation.emit(boost::asio::cancellation_type::terminal);
+    accepted = {};
+    accepted_timer.cancel();
+  }
+
+  const std::shared_ptr<boost::asio::ssl::context> context;
+  const log_source log;
+
+  bool closed = false;
+  // The error that ended the accept loop.
+  error_code accept_error;
+  std::list<boost::asio::cancellation_signal> cancellations;
+  std::queue<any_transport> accepted;
+  // Never expires. Canceled when a handshake completes or the accept loop
+  // ends.
+  boost::asio::steady_timer accepted_timer;
+};
+
+PassiveTcpTransport::PassiveTcpTransport(
+    const executor& executor,
+    const log_source& log,
+    const std::string& host,
+    const std::string& service,
+    std::shared_ptr<boost::asio::ssl::context> tls_context)
     : AsioTransport{executor, log},
       host_{host},
       service_{service},
+      tls_context_{std::move(tls_context)},
       resolver_{executor},
-      acceptor_{executor} {}
+      acceptor_{std::make_shared<Acceptor>(executor)} {}
 
 PassiveTcpTransport::~PassiveTcpTransport() {
-  // The base class closes the core on destruction.
+  // The base class closes the core on destruction. The TLS accept loop ends
+  // once the acceptor is closed.
+  if (tls_handshakes_)
+    tls_handshakes_->Close();
+  boost::system::error_code ignored;
+  acceptor_->close(ignored);
 }
 
 void PassiveTcpTransport::Cleanup() {
@@ -162,7 +293,7 @@ void PassiveTcpTransport::Cleanup() {
 }
 
 int PassiveTcpTransport::GetLocalPort() const {
-  return acceptor_.local_endpoint().port();
+  return acceptor_->local_endpoint().port();
 }
 
 awaitable<error_code> PassiveTcpTransport::open() {
@@ -205,6 +336,14 @@ awaitable<error_code> PassiveTcpTransport::ResolveAndBind() {
 
   connected_ = true;
 
+  if (tls_context_) {
+    tls_handshakes_ = std::make_shared<TlsHandshakes>(acceptor_->get_executor(),
+                                                      tls_context_, log_);
+    boost::asio::co_spawn(acceptor_->get_executor(),
+                          AcceptTlsConnections(acceptor_, tls_handshakes_),
+                          boost::asio::detached);
+  }
+
   co_return OK;
 }
 
@@ -215,21 +354,21 @@ boost::system::error_code PassiveTcpTransport::Bind(
   boost::system::error_code ec = boost::asio::error::fault;
 
   for (const auto& entry : results) {
-    acceptor_.open(entry.endpoint().protocol(), ec);
+    acceptor_->open(entry.endpoint().protocol(), ec);
     if (ec)
       continue;
 
-    acceptor_.set_option(Socket::reuse_address{true}, ec);
+    acceptor_->set_option(Socket::reuse_address{true}, ec);
     // TODO: Log endpoint.
-    acceptor_.bind(entry.endpoint(), ec);
+    acceptor_->bind(entry.endpoint(), ec);
 
     if (!ec)
-      acceptor_.listen(Socket::max_listen_connections, ec);
+      acceptor_->listen(Socket::max_listen_connections, ec);
 
     if (!ec)
       break;
 
-    acceptor_.close();
+    acceptor_->close();
   }
 
   return ec;
@@ -244,16 +383,22 @@ awaitable<error_code> PassiveTcpTransport::close() {
 
   closed_ = true;
   connected_ = false;
-  acceptor_.close();
+  acceptor_->close();
+  if (tls_handshakes_)
+    tls_handshakes_->Close();
 
   co_return OK;
 }
 
 awaitable<expected<any_transport>> PassiveTcpTransport::accept() {
+  if (tls_context_) {
+    co_return co_await AcceptTls();
+  }
+
   cancelation_state cancelation = cancelation_.get_state();
 
   // TODO: Use different executor.
-  auto [error, peer] = co_await acceptor_.async_accept(
+  auto [error, peer] = co_await acceptor_->async_accept(
       boost::asio::as_tuple(boost::asio::use_awaitable));
 
   if (cancelation.canceled() || closed_) {
@@ -277,6 +422,95 @@ awaitable<expected<any_transport>> PassiveTcpTransport::accept() {
       std::move(peer), log_, BOOST_CURRENT_LOCATION)};
 }
 
+awaitable<expected<any_transport>> PassiveTcpTransport::AcceptTls() {
+  if (!tls_handshakes_) {
+    co_return ERR_INVALID_HANDLE;
+  }
+
+  cancelation_state cancelation = cancelation_.get_state();
+
+  auto& handshakes = *tls_handshakes_;
+  while (handshakes.accepted.empty() && !handshakes.accept_error &&
+         !handshakes.closed) {
+    co_await handshakes.accepted_timer.async_wait(
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+
+    if (cancelation.canceled() || closed_) {
+      co_return ERR_ABORTED;
+    }
+  }
+
+  if (handshakes.closed) {
+    co_return ERR_ABORTED;
+  }
+
+  if (handshakes.accepted.empty()) {
+    auto error = handshakes.accept_error;
+    if (error != boost::asio::error::operation_aborted) {
+      log_.write(LogSeverity::Warning, "Accept connection error");
+      ProcessError(error);
+    }
+    co_return error;
+  }
+
+  auto transport = std::move(handshakes.accepted.front());
+  handshakes.accepted.pop();
+  co_return transport;
+}
+
+// static
+awaitable<void> PassiveTcpTransport::AcceptTlsConnections(
+    std::shared_ptr<Acceptor> acceptor,
+    std::shared_ptr<TlsHandshakes> handshakes) {
+  for (;;) {
+    auto [error, peer] = co_await acceptor->async_accept(
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+
+    if (handshakes->closed) {
+      co_return;
+    }
+
+    if (error) {
+      handshakes->accept_error = error;
+      handshakes->accepted_timer.cancel();
+      co_return;
+    }
+
+    // TODO: Log connection information.
+    handshakes->log.write(LogSeverity::Normal, "Connection accepted");
+
+    // The signal is only released once the handshake coroutine is gone.
+    auto cancellation =
+        handshakes->cancellations.emplace(handshakes->cancellations.end());
+    boost::asio::co_spawn(
+        acceptor->get_executor(), HandshakeTls(std::move(peer), handshakes),
+        boost::asio::bind_cancellation_slot(
+            cancellation->slot(),
+            [handshakes, cancellation](std::exception_ptr) {
+              handshakes->cancellations.erase(cancellation);
+            }));
+  }
+}
+
+// static
+awaitable<void> PassiveTcpTransport::HandshakeTls(
+    Socket peer,
+    std::shared_ptr<TlsHandshakes> handshakes) {
+  // A canceled handshake fails with `operation_aborted` instead of throwing.
+  co_await boost::asio::this_coro::throw_if_cancelled(false);
+
+  // Failures are logged by `Accept`.
+  auto transport = co_await ActiveTlsTransport::Accept(
+      std::move(peer), *handshakes->context, handshakes->log,
+      kTlsHandshakeTimeout);
+  if (!transport.ok() || handshakes->closed) {
+    co_return;
+  }
+
+  handshakes->accepted.push(std::move(*transport));
+  handshakes->accepted_timer.cancel();
+}
+
 awaitable<expected<size_t>> PassiveTcpTransport::read(std::span<char> data) {
   co_return ERR_ACCESS_DENIED;
 }
@@ -303,7 +537,7 @@ void PassiveTcpTransport::ProcessError(const boost::system::error_code& ec) {
 }
 
 std::string PassiveTcpTransport::name() const {
-  return "TCP Passive";
+  return tls_context_ ? "TLS Passive" : "TCP Passive";
 }
 
 }  // namespace transport
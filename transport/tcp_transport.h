@@ -3,8 +3,12 @@
 #include "transport/asio_transport.h"
 
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
 #include <boost/assert/source_location.hpp>
 
+#include <chrono>
+#include <memory>
+
 namespace transport {
 
 class ActiveTcpTransport final
@@ -34,6 +38,14 @@ class ActiveTcpTransport final
   [[nodiscard]] virtual awaitable<error_code> open() override;
   [[nodiscard]] virtual awaitable<expected<any_transport>> accept() override;
 
+  [[nodiscard]] virtual awaitable<expected<size_t>> read(
+      std::span<char> data) override;
+
+  [[nodiscard]] virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const override {
+    return last_receive_timestamp_;
+  }
+
  protected:
   // AsioTransport
   virtual void Cleanup() override;
@@ -45,6 +57,14 @@ class ActiveTcpTransport final
   [[nodiscard]] awaitable<error_code> ResolveAndConnect();
   [[nodiscard]] awaitable<error_code> Connect(Resolver::results_type results);
 
+  void EnableReceiveTimestamps();
+
+#if defined(__linux__)
+  // Reads with `recvmsg` to receive the timestamp control message. Returns
+  // `would_block` if there is no data.
+  expected<size_t> ReadMessage(std::span<char> data);
+#endif
+
   std::string host_;
   std::string service_;
   boost::source_location source_location_;
@@ -53,15 +73,25 @@ class ActiveTcpTransport final
 
   enum class Type { ACTIVE, ACCEPTED };
   const Type type_;
+
+  // Kernel receive timestamps (`SO_TIMESTAMPNS`) are only read on Linux.
+  bool timestamps_enabled_ = false;
+  std::optional<ReceiveTimestamp> last_receive_timestamp_;
 };
 
 class PassiveTcpTransport final
     : public AsioTransport<boost::asio::ip::tcp::socket> {
  public:
-  PassiveTcpTransport(const executor& executor,
-                      const log_source& log,
-                      const std::string& host,
-                      const std::string& service);
+  // With `tls_context`, accepted connections do the TLS server handshake and
+  // are `ActiveTlsTransport`s. The handshakes run concurrently, and `accept`
+  // returns the connections in the order they complete them. Failed
+  // handshakes are logged and skipped.
+  PassiveTcpTransport(
+      const executor& executor,
+      const log_source& log,
+      const std::string& host,
+      const std::string& service,
+      std::shared_ptr<boost::asio::ssl::context> tls_context = nullptr);
 
   ~PassiveTcpTransport();
 
@@ -72,7 +102,7 @@ class PassiveTcpTransport final
   [[nodiscard]] virtual bool connected() const override { return connected_; }
 
   [[nodiscard]] virtual executor get_executor() override {
-    return acceptor_.get_executor();
+    return acceptor_->get_executor();
   }
 
   [[nodiscard]] virtual awaitable<error_code> open() override;
@@ -92,17 +122,35 @@ class PassiveTcpTransport final
  private:
   using Socket = boost::asio::ip::tcp::socket;
   using Resolver = boost::asio::ip::tcp::resolver;
+  using Acceptor = boost::asio::ip::tcp::acceptor;
+
+  struct TlsHandshakes;
 
   [[nodiscard]] awaitable<error_code> ResolveAndBind();
   [[nodiscard]] boost::system::error_code Bind(Resolver::results_type results);
 
+  [[nodiscard]] awaitable<expected<any_transport>> AcceptTls();
+
+  // Accepts connections and starts their handshakes until the acceptor fails
+  // or is closed.
+  [[nodiscard]] static awaitable<void> AcceptTlsConnections(
+      std::shared_ptr<Acceptor> acceptor,
+      std::shared_ptr<TlsHandshakes> handshakes);
+  [[nodiscard]] static awaitable<void> HandshakeTls(
+      Socket peer,
+      std::shared_ptr<TlsHandshakes> handshakes);
+
   void ProcessError(const boost::system::error_code& ec);
 
   std::string host_;
   std::string service_;
+  const std::shared_ptr<boost::asio::ssl::context> tls_context_;
 
   Resolver resolver_;
-  boost::asio::ip::tcp::acceptor acceptor_;
+  // Shared with the TLS accept loop, which may outlive the transport.
+  const std::shared_ptr<Acceptor> acceptor_;
+  // Created on open with `tls_context_`.
+  std::shared_ptr<TlsHandshakes> tls_handshakes_;
 };
 
 }  // namespace transport
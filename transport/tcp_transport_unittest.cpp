@@ -0,0 +1,66 @@
+#include "transport/tcp_transport.h"
+
+#include "transport/any_transport.h"
+#include "transport/test/coroutine_util.h"
+#include "transport/test/test_log.h"
+
+#include <gmock/gmock.h>
+#include <array>
+#include <chrono>
+#include <string>
+
+namespace transport {
+
+TEST(TcpTransportTest, ReadReportsReceiveTimestamp) {
+  auto log = log_source{std::make_shared<TestLogSink>()};
+
+  CoTest([&]() -> awaitable<void> {
+    auto executor = co_await boost::asio::this_coro::executor;
+    PassiveTcpTransport server{executor, log.with_channel("Server"),
+                               "127.0.0.1", "0"};
+    NET_EXPECT_OK(co_await server.open());
+
+    ActiveTcpTransport client{executor, log.with_channel("Client"),
+                              "127.0.0.1",
+                              std::to_string(server.GetLocalPort())};
+
+    // The connection completes in the listen backlog before it is accepted.
+    NET_EXPECT_OK(co_await client.open());
+    auto accepted_result = co_await server.accept();
+    EXPECT_TRUE(accepted_result.ok());
+    if (!accepted_result.ok())
+      co_return;
+    auto accepted = std::move(*accepted_result);
+    EXPECT_EQ(accepted.last_receive_timestamp(), std::nullopt);
+
+    const auto time_before_write = std::chrono::system_clock::now();
+
+    constexpr std::array<char, 4> kRequest = {'p', 'i', 'n', 'g'};
+    auto written_result = co_await client.write(kRequest);
+    EXPECT_TRUE(written_result.ok());
+
+    std::array<char, 16> read_buffer{};
+    auto read_result = co_await accepted.read(read_buffer);
+    EXPECT_EQ(read_result, kRequest.size());
+
+#if defined(__linux__)
+    const auto timestamp = accepted.last_receive_timestamp();
+    EXPECT_TRUE(timestamp.has_value());
+    if (timestamp) {
+      // Allow for the system clock being adjusted during the test.
+      EXPECT_GE(*timestamp, time_before_write - std::chrono::seconds{1});
+      EXPECT_LE(*timestamp,
+                std::chrono::system_clock::now() + std::chrono::seconds{1});
+    }
+#endif
+
+    // A graceful close reads as `eof`, as with `async_read_some`.
+    NET_EXPECT_OK(co_await client.close());
+    auto eof_result = co_await accepted.read(read_buffer);
+    EXPECT_EQ(eof_result.error(), boost::asio::error::eof);
+
+    NET_EXPECT_OK(co_await server.close());
+  });
+}
+
+}  // namespace transport
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace transport {
+
+// A hashed timer wheel. Entries are scheduled a number of ticks ahead and
+// reported by `Advance`, which is expected to be called once per tick.
+// Scheduling is O(1) and there is no cancelation: owners are expected to
+// check whether a reported entry is still relevant, which allows to refresh
+// deadlines lazily instead of rescheduling on every activity.
+template <class Key>
+class TimerWheel {
+ public:
+  explicit TimerWheel(size_t slot_count = 64) : slots_(slot_count) {
+    assert(slot_count != 0);
+  }
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // The number of ticks passed.
+  uint64_t now() const { return now_; }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // `ticks` must not be zero.
+  void Schedule(Key key, uint64_t ticks) {
+    assert(ticks != 0);
+    const uint64_t deadline = now_ + ticks;
+    slots_[deadline % slots_.size()].push_back({std::move(key), deadline});
+    ++size_;
+  }
+
+  // Advances the wheel by one tick and calls `callback(key)` for each expired
+  // entry. The callback may schedule new entries.
+  template <class Callback>
+  void Advance(Callback&& callback) {
+    ++now_;
+
+    auto& slot = slots_[now_ % slots_.size()];
+    if (slot.empty()) {
+      return;
+    }
+
+    // Entries scheduled from the callback may land in the same slot.
+    auto entries = std::exchange(slot, {});
+    for (auto& entry : entries) {
+      if (entry.deadline > now_) {
+        slot.push_back(std::move(entry));
+      } else {
+        --size_;
+        callback(std::move(entry.key));
+      }
+    }
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    uint64_t deadline = 0;
+  };
+
+  std::vector<std::vector<Entry>> slots_;
+  uint64_t now_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace transport
@@ -0,0 +1,42 @@
+#include "transport/timer_wheel.h"
+
+#include <gmock/gmock.h>
+
+using namespace testing;
+
+namespace transport {
+
+TEST(TimerWheel, ReportsEntriesAtDeadline) {
+  TimerWheel<int> wheel{4};
+  wheel.Schedule(1, 1);
+  wheel.Schedule(2, 3);
+  // Wraps around the wheel.
+  wheel.Schedule(3, 6);
+
+  std::vector<std::pair<uint64_t, int>> expired;
+  for (int i = 0; i < 8; ++i) {
+    wheel.Advance([&](int key) { expired.emplace_back(wheel.now(), key); });
+  }
+
+  EXPECT_THAT(expired, ElementsAre(Pair(1, 1), Pair(3, 2), Pair(6, 3)));
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, CallbackCanReschedule) {
+  TimerWheel<int> wheel{4};
+  wheel.Schedule(1, 4);
+
+  std::vector<uint64_t> expired;
+  for (int i = 0; i < 12; ++i) {
+    wheel.Advance([&](int key) {
+      expired.push_back(wheel.now());
+      // Lands in the slot being processed.
+      wheel.Schedule(key, 4);
+    });
+  }
+
+  EXPECT_THAT(expired, ElementsAre(4, 8, 12));
+  EXPECT_EQ(wheel.size(), 1u);
+}
+
+}  // namespace transport
@@ -0,0 +1,162 @@
+#include "transport/tls_context.h"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ssl/context_base.hpp>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+namespace transport {
+
+error_code ConfigureServerTlsContext(boost::asio::ssl::context& context,
+                                     const WebSocketServerTlsConfig& config) {
+  boost::system::error_code ec;
+
+  context.set_options(boost::asio::ssl::context::default_workarounds |
+                          boost::asio::ssl::context::no_sslv2 |
+                          boost::asio::ssl::context::no_sslv3 |
+                          boost::asio::ssl::context::single_dh_use,
+                      ec);
+  if (ec)
+    return ec;
+
+  if (!config.private_key_passphrase.empty()) {
+    context.set_password_callback(
+        [password = config.private_key_passphrase](
+            std::size_t,
+            boost::asio::ssl::context_base::password_purpose) {
+          return password;
+        });
+  }
+
+  context.use_certificate_chain(
+      boost::asio::buffer(config.certificate_chain_pem), ec);
+  if (ec)
+    return ec;
+
+  context.use_private_key(boost::asio::buffer(config.private_key_pem),
+                          boost::asio::ssl::context::file_format::pem, ec);
+  if (ec)
+    return ec;
+
+  return OK;
+}
+
+error_code ConfigureClientTlsContext(boost::asio::ssl::context& context,
+                                     const WebSocketClientTlsConfig& config) {
+  boost::system::error_code ec;
+
+  context.set_options(boost::asio::ssl::context::default_workarounds |
+                          boost::asio::ssl::context::no_sslv2 |
+                          boost::asio::ssl::context::no_sslv3,
+                      ec);
+  if (ec)
+    return ec;
+
+  context.set_verify_mode(config.verify_peer ? boost::asio::ssl::verify_peer
+                                             : boost::asio::ssl::verify_none,
+                          ec);
+  if (ec)
+    return ec;
+
+  if (!config.ca_certificate_pem.empty()) {
+    context.add_certificate_authority(
+        boost::asio::buffer(config.ca_certificate_pem), ec);
+    if (ec)
+      return ec;
+  }
+
+  return OK;
+}
+
+expected<std::shared_ptr<boost::asio::ssl::context>> CreateServerTlsContext(
+    const WebSocketServerTlsConfig& config) {
+  auto context = std::make_shared<boost::asio::ssl::context>(
+      boost::asio::ssl::context::tls_server);
+  if (auto ec = ConfigureServerTlsContext(*context, config); ec != OK)
+    return ec;
+  return context;
+}
+
+// TlsClientContext
+
+// static
+expected<std::shared_ptr<TlsClientContext>> TlsClientContext::Create(
+    const WebSocketClientTlsConfig& config) {
+  std::shared_ptr<TlsClientContext> result{new TlsClientContext};
+  if (auto ec = ConfigureClientTlsContext(result->context_, config); ec != OK)
+    return ec;
+  return result;
+}
+
+TlsClientContext::TlsClientContext()
+    : context_{boost::asio::ssl::context::tls_client} {
+  auto* ssl_context = context_.native_handle();
+  SSL_CTX_set_app_data(ssl_context, this);
+  // Sessions are looked up by server name, not by OpenSSL's internal cache.
+  SSL_CTX_set_session_cache_mode(
+      ssl_context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ssl_context, &TlsClientContext::OnNewSession);
+}
+
+TlsClientContext::~TlsClientContext() {
+  // Connections may outlive the context object.
+  SSL_CTX_set_app_data(context_.native_handle(), nullptr);
+}
+
+bool TlsClientContext::SetServerName(SSL* ssl,
+                                     const std::string& server_name) {
+  if (!SSL_set_tlsext_host_name(ssl, server_name.c_str())) {
+    return false;
+  }
+
+  // Only checked with `verify_peer`.
+  boost::system::error_code ec;
+  boost::asio::ip::make_address(server_name, ec);
+  if (!ec) {
+    return X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl),
+                                         server_name.c_str()) == 1;
+  }
+  return SSL_set1_host(ssl, server_name.c_str()) == 1;
+}
+
+void TlsClientContext::PrepareSession(SSL* ssl,
+                                      const std::string& server_name) {
+  std::lock_guard lock{mutex_};
+  auto i = sessions_.find(server_name);
+  if (i != sessions_.end()) {
+    SSL_set_session(ssl, i->second.get());
+  }
+}
+
+void TlsClientContext::ForgetSession(const std::string& server_name) {
+  std::lock_guard lock{mutex_};
+  sessions_.erase(server_name);
+}
+
+void TlsClientContext::OnHandshake(SSL* ssl) {
+  if (SSL_session_reused(ssl)) {
+    resumed_sessions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// static
+int TlsClientContext::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+  auto* self = static_cast<TlsClientContext*>(
+      SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  const char* server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  if (!self || !server_name || !SSL_SESSION_is_resumable(session)) {
+    return 0;
+  }
+
+  std::lock_guard lock{self->mutex_};
+  self->sessions_.insert_or_assign(server_name, SessionPtr{session});
+  // Took over the session reference.
+  return 1;
+}
+
+void TlsClientContext::SessionDeleter::operator()(SSL_SESSION* session) const {
+  SSL_SESSION_free(session);
+}
+
+}  // namespace transport
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "transport/error.h"
+#include "transport/expected.h"
+
+#include <boost/asio/ssl/context.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_session_st SSL_SESSION;
+
+namespace transport {
+
+struct WebSocketServerTlsConfig {
+  std::string certificate_chain_pem;
+  std::string private_key_pem;
+  std::string private_key_passphrase;
+  // Lets OpenSSL offload the record crypto to the kernel after the handshake.
+  // See `KernelTlsStream`.
+  bool kernel_tls = false;
+};
+
+struct WebSocketClientTlsConfig {
+  bool verify_peer = false;
+  std::string server_name;
+  std::string ca_certificate_pem;
+  // See `WebSocketServerTlsConfig::kernel_tls`.
+  bool kernel_tls = false;
+};
+
+[[nodiscard]] error_code ConfigureServerTlsContext(
+    boost::asio::ssl::context& context,
+    const WebSocketServerTlsConfig& config);
+
+[[nodiscard]] error_code ConfigureClientTlsContext(
+    boost::asio::ssl::context& context,
+    const WebSocketClientTlsConfig& config);
+
+// A server TLS context that can be shared by transports, so the certificate
+// and the key are parsed once, and session tickets issued by one listener are
+// accepted by the others.
+[[nodiscard]] expected<std::shared_ptr<boost::asio::ssl::context>>
+CreateServerTlsContext(const WebSocketServerTlsConfig& config);
+
+// A client TLS context that can be shared by transports. Keeps the last
+// session, either a TLS 1.2 session ticket or a TLS 1.3 PSK, of each server
+// name, so that reconnects do abbreviated handshakes. Thread-safe.
+class TlsClientContext {
+ public:
+  [[nodiscard]] static expected<std::shared_ptr<TlsClientContext>> Create(
+      const WebSocketClientTlsConfig& config);
+
+  ~TlsClientContext();
+
+  TlsClientContext(const TlsClientContext&) = delete;
+  TlsClientContext& operator=(const TlsClientContext&) = delete;
+
+  boost::asio::ssl::context& context() { return context_; }
+
+  // Sets the server name sent in SNI, which the certificate must also match if
+  // the peer is verified. A name that is an IP address must match an IP
+  // address of the certificate. Returns false if the name is invalid.
+  [[nodiscard]] bool SetServerName(SSL* ssl, const std::string& server_name);
+
+  // Offers the cached session of `server_name` for resumption. Must be called
+  // before the handshake and after the server name is set on `ssl`.
+  void PrepareSession(SSL* ssl, const std::string& server_name);
+
+  // Drops the cached session of `server_name`, e.g. on a failed handshake.
+  void ForgetSession(const std::string& server_name);
+
+  // Counts the handshake on `ssl` if it resumed a session.
+  void OnHandshake(SSL* ssl);
+
+  // The number of handshakes that resumed a session.
+  [[nodiscard]] uint64_t resumed_sessions() const {
+    return resumed_sessions_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct SessionDeleter {
+    void operator()(SSL_SESSION* session) const;
+  };
+
+  using SessionPtr = std::unique_ptr<SSL_SESSION, SessionDeleter>;
+
+  TlsClientContext();
+
+  static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+
+  boost::asio::ssl::context context_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, SessionPtr> sessions_;
+
+  std::atomic<uint64_t> resumed_sessions_ = 0;
+};
+
+}  // namespace transport
@@ -0,0 +1,238 @@
+#include "transport/tls_transport.h"
+
+#include "transport/any_transport.h"
+#include "transport/log.h"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <openssl/ssl.h>
+
+namespace transport {
+
+namespace {
+
+// Peers of stream protocols commonly close the connection without the TLS
+// close notification. Report it as a graceful close, like TCP does. Framing
+// detects truncated messages.
+void IgnoreUnexpectedEof(SSL* ssl) {
+#if defined(SSL_OP_IGNORE_UNEXPECTED_EOF)
+  SSL_set_options(ssl, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+}
+
+struct HandshakeDeadline {
+  bool done = false;
+  bool expired = false;
+};
+
+}  // namespace
+
+ActiveTlsTransport::ActiveTlsTransport(
+    const executor& executor,
+    const log_source& log,
+    const std::string& host,
+    const std::string& service,
+    std::shared_ptr<TlsClientContext> tls_context,
+    std::string server_name,
+    const boost::source_location& source_location)
+    : AsioTransport{log, std::in_place, executor, tls_context->context()},
+      host_{host},
+      service_{service},
+      server_name_{server_name.empty() ? host : std::move(server_name)},
+      tls_context_{std::move(tls_context)},
+      source_location_{source_location},
+      resolver_{executor},
+      type_{Type::ACTIVE} {
+  IgnoreUnexpectedEof(io_object_.native_handle());
+}
+
+ActiveTlsTransport::ActiveTlsTransport(
+    Stream stream,
+    const log_source& log,
+    const boost::source_location& source_location)
+    : AsioTransport{log, std::in_place, std::move(stream)},
+      source_location_{source_location},
+      resolver_{io_object_.get_executor()},
+      type_{Type::ACCEPTED} {
+  IgnoreUnexpectedEof(io_object_.native_handle());
+  connected_ = true;
+}
+
+ActiveTlsTransport::~ActiveTlsTransport() {
+  // The base class closes the core on destruction.
+}
+
+// static
+awaitable<expected<any_transport>> ActiveTlsTransport::Accept(
+    boost::asio::ip::tcp::socket socket,
+    boost::asio::ssl::context& context,
+    const log_source& log,
+    std::chrono::steady_clock::duration timeout) {
+  Stream stream{std::move(socket), context};
+
+  // The timer handler may run after the stream is moved or destroyed, so it
+  // touches the socket only while the handshake is pending.
+  auto deadline = std::make_shared<HandshakeDeadline>();
+  boost::asio::steady_timer timer{stream.get_executor(), timeout};
+  timer.async_wait(
+      [deadline, &socket = stream.next_layer()](error_code ec) {
+        if (ec || deadline->done)
+          return;
+        deadline->expired = true;
+        boost::system::error_code ignored;
+        socket.cancel(ignored);
+      });
+
+  auto [error] = co_await stream.async_handshake(
+      boost::asio::ssl::stream_base::server,
+      boost::asio::as_tuple(boost::asio::use_awaitable));
+  deadline->done = true;
+  timer.cancel();
+
+  if (deadline->expired) {
+    log.write(LogSeverity::Warning, "TLS handshake timed out");
+    co_return ERR_TIMED_OUT;
+  }
+
+  if (error) {
+    log.write(LogSeverity::Warning, "TLS handshake error: {}",
+              ErrorToShortString(error));
+    co_return error;
+  }
+
+  co_return any_transport{std::make_unique<ActiveTlsTransport>(
+      std::move(stream), log, BOOST_CURRENT_LOCATION)};
+}
+
+std::string ActiveTlsTransport::name() const {
+  switch (type_) {
+    case Type::ACTIVE:
+      return "TLS Active";
+    case Type::ACCEPTED:
+      return "TLS Accepted";
+    default:
+      assert(false);
+      return "TLS Unknown";
+  }
+}
+
+awaitable<expected<any_transport>> ActiveTlsTransport::accept() {
+  co_return ERR_ACCESS_DENIED;
+}
+
+awaitable<error_code> ActiveTlsTransport::open() {
+  if (connected_) {
+    co_return OK;
+  }
+
+  log_.write(LogSeverity::Normal, "Open");
+
+  co_return co_await ResolveAndConnect();
+}
+
+awaitable<error_code> ActiveTlsTransport::ResolveAndConnect() {
+  log_.write(LogSeverity::Normal, "Start DNS resolution to {}:{}",
+              host_, service_);
+
+  cancelation_state cancelation = cancelation_.get_state();
+
+  auto [error, results] = co_await resolver_.async_resolve(
+      host_, service_, boost::asio::as_tuple(boost::asio::use_awaitable));
+
+  if (cancelation.canceled() || closed_) {
+    co_return ERR_ABORTED;
+  }
+
+  if (error) {
+    if (error != boost::asio::error::operation_aborted) {
+      log_.write(LogSeverity::Warning, "DNS resolution error");
+      ProcessError(error);
+    }
+    co_return error;
+  }
+
+  log_.write(LogSeverity::Normal, "DNS resolution completed");
+
+  co_return co_await Connect(std::move(results));
+}
+
+awaitable<error_code> ActiveTlsTransport::Connect(
+    Resolver::results_type results) {
+  cancelation_state cancelation = cancelation_.get_state();
+
+  auto [error, endpoint] = co_await boost::asio::async_connect(
+      io_object_.next_layer(), results,
+      boost::asio::as_tuple(boost::asio::use_awaitable));
+
+  if (cancelation.canceled() || closed_) {
+    co_return ERR_ABORTED;
+  }
+
+  if (error) {
+    if (error != boost::asio::error::operation_aborted) {
+      log_.write(LogSeverity::Warning, "Connect error");
+      ProcessError(error);
+    }
+    co_return error;
+  }
+
+  log_.write(LogSeverity::Normal, "Connected to {}:{}",
+              endpoint.address().to_string(), endpoint.port());
+
+  co_return co_await Handshake();
+}
+
+awaitable<error_code> ActiveTlsTransport::Handshake() {
+  auto* ssl = io_object_.native_handle();
+  if (!tls_context_->SetServerName(ssl, server_name_)) {
+    log_.write(LogSeverity::Warning, "Invalid TLS server name");
+    ProcessError(ERR_INVALID_ARGUMENT);
+    co_return ERR_INVALID_ARGUMENT;
+  }
+
+  tls_context_->PrepareSession(ssl, server_name_);
+
+  cancelation_state cancelation = cancelation_.get_state();
+
+  auto [error] = co_await io_object_.async_handshake(
+      boost::asio::ssl::stream_base::client,
+      boost::asio::as_tuple(boost::asio::use_awaitable));
+
+  if (cancelation.canceled() || closed_) {
+    co_return ERR_ABORTED;
+  }
+
+  if (error) {
+    tls_context_->ForgetSession(server_name_);
+    if (error != boost::asio::error::operation_aborted) {
+      log_.write(LogSeverity::Warning, "TLS handshake error");
+      ProcessError(error);
+    }
+    co_return error;
+  }
+
+  tls_context_->OnHandshake(ssl);
+  log_.write(LogSeverity::Normal, "TLS handshake completed{}",
+              SSL_session_reused(ssl) ? ", session resumed" : "");
+
+  connected_ = true;
+
+  co_return OK;
+}
+
+void ActiveTlsTransport::Cleanup() {
+  assert(closed_);
+
+  log_.write(LogSeverity::Normal, "Cleanup");
+
+  connected_ = false;
+
+  resolver_.cancel();
+
+  // Closes without the TLS close notification. See `IgnoreUnexpectedEof`.
+  boost::system::error_code ec;
+  io_object_.next_layer().cancel(ec);
+  io_object_.next_layer().close(ec);
+}
+
+}  // namespace transport
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "transport/asio_transport.h"
+#include "transport/tls_context.h"
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/assert/source_location.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace transport {
+
+// TLS directly over TCP, for stream protocols that need encryption without
+// the WebSocket framing. Passive TLS transports are `PassiveTcpTransport`s
+// with a TLS context.
+class ActiveTlsTransport final
+    : public AsioTransport<
+          boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> {
+ public:
+  using Stream = boost::asio::ssl::stream<boost::asio::ip::tcp::socket>;
+
+  // The server name is sent in SNI and keys the session cache. Defaults to
+  // `host`.
+  ActiveTlsTransport(
+      const executor& executor,
+      const log_source& log,
+      const std::string& host,
+      const std::string& service,
+      std::shared_ptr<TlsClientContext> tls_context,
+      std::string server_name = {},
+      const boost::source_location& source_location = BOOST_CURRENT_LOCATION);
+
+  // A constructor for a stream accepted by a passive TCP transport, with the
+  // handshake completed.
+  ActiveTlsTransport(
+      Stream stream,
+      const log_source& log,
+      const boost::source_location& source_location = BOOST_CURRENT_LOCATION);
+
+  ~ActiveTlsTransport();
+
+  // Does the server handshake on an accepted socket. Fails with
+  // `ERR_TIMED_OUT` if the handshake doesn't complete in `timeout`.
+  [[nodiscard]] static awaitable<expected<any_transport>> Accept(
+      boost::asio::ip::tcp::socket socket,
+      boost::asio::ssl::context& context,
+      const log_source& log,
+      std::chrono::steady_clock::duration timeout);
+
+  [[nodiscard]] virtual std::string name() const override;
+  [[nodiscard]] virtual bool active() const override {
+    return type_ == Type::ACTIVE;
+  }
+
+  [[nodiscard]] virtual awaitable<error_code> open() override;
+  [[nodiscard]] virtual awaitable<expected<any_transport>> accept() override;
+
+ protected:
+  // AsioTransport
+  virtual void Cleanup() override;
+
+ private:
+  using Resolver = boost::asio::ip::tcp::resolver;
+
+  [[nodiscard]] awaitable<error_code> ResolveAndConnect();
+  [[nodiscard]] awaitable<error_code> Connect(Resolver::results_type results);
+  [[nodiscard]] awaitable<error_code> Handshake();
+
+  std::string host_;
+  std::string service_;
+  std::string server_name_;
+  std::shared_ptr<TlsClientContext> tls_context_;
+  boost::source_location source_location_;
+
+  Resolver resolver_;
+
+  enum class Type { ACTIVE, ACCEPTED };
+  const Type type_;
+};
+
+}  // namespace transport
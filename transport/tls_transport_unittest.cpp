@@ -0,0 +1,155 @@
+#include "transport/tls_transport.h"
+
+#include "transport/any_transport.h"
+#include "transport/tcp_transport.h"
+#include "transport/test/coroutine_util.h"
+#include "transport/test/test_log.h"
+#include "transport/test/test_tls.h"
+
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <gmock/gmock.h>
+#include <array>
+#include <chrono>
+#include <string>
+
+namespace transport {
+namespace {
+
+log_source MakeTestLog() {
+  return log_source{std::make_shared<TestLogSink>()};
+}
+
+std::shared_ptr<boost::asio::ssl::context> MakeServerContext() {
+  auto context = CreateServerTlsContext({
+      .certificate_chain_pem = kTestCertificatePem,
+      .private_key_pem = kTestPrivateKeyPem,
+  });
+  EXPECT_TRUE(context.ok());
+  return context.ok() ? std::move(*context) : nullptr;
+}
+
+std::shared_ptr<TlsClientContext> MakeClientContext() {
+  auto context = TlsClientContext::Create({.verify_peer = false});
+  EXPECT_TRUE(context.ok());
+  return context.ok() ? std::move(*context) : nullptr;
+}
+
+}  // namespace
+
+using namespace boost::asio::experimental::awaitable_operators;
+
+TEST(TlsTransportTest, ActiveAndAcceptedExchangeData) {
+  auto log = MakeTestLog();
+
+  CoTest([&]() -> awaitable<void> {
+    auto executor = co_await boost::asio::this_coro::executor;
+    PassiveTcpTransport server{executor, log.with_channel("Server"),
+                               "127.0.0.1", "0", MakeServerContext()};
+    NET_EXPECT_OK(co_await server.open());
+    EXPECT_EQ(server.name(), "TLS Passive");
+
+    ActiveTlsTransport client{executor, log.with_channel("Client"),
+                              "127.0.0.1",
+                              std::to_string(server.GetLocalPort()),
+                              MakeClientContext()};
+
+    // The handshakes of both sides must run concurrently.
+    auto [open_result, accepted_result] =
+        co_await (client.open() && server.accept());
+    NET_EXPECT_OK(open_result);
+    EXPECT_TRUE(client.connected());
+    EXPECT_TRUE(accepted_result.ok());
+    if (!accepted_result.ok())
+      co_return;
+    auto accepted = std::move(*accepted_result);
+    EXPECT_EQ(accepted.name(), "TLS Accepted");
+
+    constexpr std::array<char, 5> kRequest = {'h', 'e', 'l', 'l', 'o'};
+    auto written_result = co_await client.write(kRequest);
+    EXPECT_TRUE(written_result.ok());
+
+    std::array<char, 16> read_buffer{};
+    auto read_result = co_await accepted.read(read_buffer);
+    EXPECT_TRUE(read_result.ok());
+    if (!read_result.ok())
+      co_return;
+    EXPECT_EQ(*read_result, kRequest.size());
+
+    // Closing without the TLS close notification reads as a graceful close.
+    NET_EXPECT_OK(co_await client.close());
+    auto eof_result = co_await accepted.read(read_buffer);
+    EXPECT_EQ(eof_result.error(), boost::asio::error::eof);
+
+    NET_EXPECT_OK(co_await server.close());
+  });
+}
+
+TEST(TlsTransportTest, VerifiedPeerMustMatchServerName) {
+  auto log = MakeTestLog();
+
+  CoTest([&]() -> awaitable<void> {
+    auto executor = co_await boost::asio::this_coro::executor;
+    PassiveTcpTransport server{executor, log.with_channel("Server"),
+                               "127.0.0.1", "0", MakeServerContext()};
+    NET_EXPECT_OK(co_await server.open());
+
+    // Trusts the self-signed certificate of `localhost`.
+    auto tls_context = TlsClientContext::Create(
+        {.verify_peer = true, .ca_certificate_pem = kTestCertificatePem});
+    EXPECT_TRUE(tls_context.ok());
+    if (!tls_context.ok())
+      co_return;
+
+    const auto port = std::to_string(server.GetLocalPort());
+    ActiveTlsTransport wrong_name_client{executor, log.with_channel("Client"),
+                                         "127.0.0.1", port, *tls_context,
+                                         "example.com"};
+    EXPECT_NE(co_await wrong_name_client.open(), OK);
+
+    // The server skips the failed handshake.
+    ActiveTlsTransport client{executor, log.with_channel("Client"),
+                              "127.0.0.1", port, *tls_context, "localhost"};
+    NET_EXPECT_OK(co_await client.open());
+    auto accepted_result = co_await server.accept();
+    EXPECT_TRUE(accepted_result.ok());
+
+    NET_EXPECT_OK(co_await server.close());
+  });
+}
+
+TEST(TlsTransportTest, PassiveTransportAcceptsDuringStalledHandshake) {
+  auto log = MakeTestLog();
+
+  CoTest([&]() -> awaitable<void> {
+    auto executor = co_await boost::asio::this_coro::executor;
+    PassiveTcpTransport server{executor, log.with_channel("Server"),
+                               "127.0.0.1", "0", MakeServerContext()};
+    NET_EXPECT_OK(co_await server.open());
+
+    // Connects but never starts the handshake.
+    boost::asio::ip::tcp::socket idle_client{executor};
+    auto [connect_error] = co_await idle_client.async_connect(
+        {boost::asio::ip::make_address("127.0.0.1"),
+         static_cast<unsigned short>(server.GetLocalPort())},
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+    EXPECT_FALSE(connect_error);
+
+    ActiveTlsTransport client{executor, log.with_channel("Client"),
+                              "127.0.0.1",
+                              std::to_string(server.GetLocalPort()),
+                              MakeClientContext()};
+
+    // Doesn't wait for the handshake timeout of the idle client.
+    const auto start_time = std::chrono::steady_clock::now();
+    auto [open_result, accepted_result] =
+        co_await (client.open() && server.accept());
+    NET_EXPECT_OK(open_result);
+    EXPECT_TRUE(accepted_result.ok());
+    EXPECT_LT(std::chrono::steady_clock::now() - start_time,
+              std::chrono::seconds{5});
+
+    NET_EXPECT_OK(co_await server.close());
+  });
+}
+
+}  // namespace transport
@@ -6,8 +6,10 @@
 #include "transport/expected.h"
 
 #include <cassert>
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <span>
 #include <string>
 
@@ -15,6 +17,9 @@ namespace transport {
 
 class any_transport;
 
+// The time the kernel received data, in the system clock.
+using ReceiveTimestamp = std::chrono::system_clock::time_point;
+
 class Connector {
  public:
   virtual ~Connector() = default;
@@ -40,6 +45,14 @@ class Reader {
   // completes. Returns zero when transport is closed.
   [[nodiscard]] virtual awaitable<expected<size_t>> read(
       std::span<char> buffer) = 0;
+
+  // The kernel receive time of the data returned by the last `read`, if the
+  // transport records it. For a stream it is the time of the last received
+  // segment.
+  [[nodiscard]] virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const {
+    return std::nullopt;
+  }
 };
 
 class TransportMetadata {
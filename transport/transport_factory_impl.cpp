@@ -1,9 +1,15 @@
 #include "transport/transport_factory_impl.h"
 
+#include "transport/delimiter_message_reader.h"
+#include "transport/fragmenting_transport.h"
+#include "transport/framing_message_reader.h"
 #include "transport/inprocess_transport.h"
 #include "transport/log.h"
+#include "transport/message_buffer_pool.h"
+#include "transport/message_reader_transport.h"
 #include "transport/serial_transport.h"
 #include "transport/tcp_transport.h"
+#include "transport/tls_transport.h"
 #include "transport/transport_string.h"
 #include "transport/udp_socket_impl.h"
 #include "transport/udp_transport.h"
@@ -13,8 +19,12 @@
 #include "transport/pipe_transport.h"
 #endif
 
+#include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/locale/encoding_utf.hpp>
+#include <fstream>
+#include <optional>
+#include <sstream>
 #include <thread>
 
 #if defined(_WIN32)
@@ -59,6 +69,160 @@ boost::asio::serial_port::flow_control::type ParseFlowControl(
     throw std::invalid_argument{"Wrong flow control string"};
 }
 
+std::optional<UdpOverflowPolicy> ParseUdpOverflowPolicy(std::string_view str) {
+  if (boost::iequals(str, TransportString::kOverflowDropNewest))
+    return UdpOverflowPolicy::DROP_NEWEST;
+  else if (boost::iequals(str, TransportString::kOverflowDropOldest))
+    return UdpOverflowPolicy::DROP_OLDEST;
+  else if (boost::iequals(str, TransportString::kOverflowPauseReading))
+    return UdpOverflowPolicy::PAUSE_READING;
+  else
+    return std::nullopt;
+}
+
+size_t GetParamSize(const TransportString& transport_string,
+                    std::string_view name,
+                    size_t default_value) {
+  if (!transport_string.HasParam(name))
+    return default_value;
+  return static_cast<size_t>(std::max(0, transport_string.GetParamInt(name)));
+}
+
+// TCP;Active;Host=device;Port=3000;Framing=u16le;HeaderOffset=2
+// TCP;Passive;Port=3000;Framing=u32be;MaxMessageSize=1048576
+// SERIAL;Name=COM2;Framing=fixed;RecordSize=16
+std::optional<MessageFraming> ParseMessageFraming(
+    const TransportString& transport_string) {
+  const auto str = transport_string.GetParamStr(TransportString::kParamFraming);
+
+  MessageFraming framing;
+  if (boost::iequals(str, TransportString::kFramingU16Le) ||
+      boost::iequals(str, TransportString::kFramingU16Be)) {
+    framing.length_bytes = 2;
+    framing.big_endian = boost::iequals(str, TransportString::kFramingU16Be);
+  } else if (boost::iequals(str, TransportString::kFramingU32Le) ||
+             boost::iequals(str, TransportString::kFramingU32Be)) {
+    framing.length_bytes = 4;
+    framing.big_endian = boost::iequals(str, TransportString::kFramingU32Be);
+  } else if (boost::iequals(str, TransportString::kFramingVarint)) {
+    framing.type = MessageFraming::Type::VARINT_PREFIX;
+  } else if (boost::iequals(str, TransportString::kFramingFixed)) {
+    framing.type = MessageFraming::Type::FIXED_SIZE;
+  } else {
+    return std::nullopt;
+  }
+
+  framing.header_offset =
+      GetParamSize(transport_string, TransportString::kParamHeaderOffset, 0);
+  framing.record_size =
+      GetParamSize(transport_string, TransportString::kParamRecordSize, 0);
+  framing.max_message_size =
+      GetParamSize(transport_string, TransportString::kParamMaxMessageSize,
+                   framing.max_message_size);
+
+  if (!FramingMessageReader::IsValid(framing))
+    return std::nullopt;
+  return framing;
+}
+
+// SERIAL;Name=COM2;Framing=stxetx;MaxMessageSize=1024
+std::optional<DelimiterFraming> ParseDelimiterFraming(
+    const TransportString& transport_string) {
+  const auto str = transport_string.GetParamStr(TransportString::kParamFraming);
+
+  DelimiterFraming framing;
+  if (boost::iequals(str, TransportString::kFramingLf)) {
+    framing.type = DelimiterFraming::Type::LF;
+  } else if (boost::iequals(str, TransportString::kFramingCrLf)) {
+    framing.type = DelimiterFraming::Type::CRLF;
+  } else if (boost::iequals(str, TransportString::kFramingStxEtx)) {
+    framing.type = DelimiterFraming::Type::STX_ETX;
+  } else {
+    return std::nullopt;
+  }
+
+  framing.max_message_size =
+      GetParamSize(transport_string, TransportString::kParamMaxMessageSize,
+                   framing.max_message_size);
+  if (framing.max_message_size == 0)
+    return std::nullopt;
+  return framing;
+}
+
+// Returns null if the framing is wrong.
+std::unique_ptr<MessageReader> CreateFramingMessageReader(
+    const TransportString& transport_string,
+    const std::shared_ptr<MessageBufferPool>& pool) {
+  if (auto framing = ParseMessageFraming(transport_string))
+    return std::make_unique<FramingMessageReader>(*framing, pool);
+  if (auto framing = ParseDelimiterFraming(transport_string))
+    return std::make_unique<DelimiterMessageReader>(*framing, pool);
+  return nullptr;
+}
+
+// Returns nothing if the file can't be read.
+std::optional<std::string> ReadFile(std::string_view path) {
+  std::ifstream file{std::string{path}, std::ios::binary};
+  if (!file)
+    return std::nullopt;
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return std::move(contents).str();
+}
+
+// TCP;Active;Host=server;Port=3000;TLS=1;VerifyPeer=1;CaCertificate=ca.pem
+expected<WebSocketClientTlsConfig> ParseClientTlsConfig(
+    const TransportString& transport_string,
+    const log_source& log) {
+  WebSocketClientTlsConfig config;
+  config.verify_peer =
+      transport_string.HasParam(TransportString::kParamVerifyPeer) &&
+      transport_string.GetParamInt(TransportString::kParamVerifyPeer) != 0;
+  config.server_name =
+      transport_string.GetParamStr(TransportString::kParamServerName);
+  if (transport_string.HasParam(TransportString::kParamCaCertificate)) {
+    auto ca_certificate = ReadFile(
+        transport_string.GetParamStr(TransportString::kParamCaCertificate));
+    if (!ca_certificate) {
+      log.write(LogSeverity::Warning, "Cannot read the CA certificate");
+      return ERR_INVALID_ARGUMENT;
+    }
+    config.ca_certificate_pem = std::move(*ca_certificate);
+  }
+
+  return config;
+}
+
+// TCP;Passive;Port=3000;TLS=1;Certificate=server.pem;PrivateKey=server.key
+expected<any_transport> CreatePassiveTlsTransport(
+    const TransportString& transport_string,
+    const executor& executor,
+    const log_source& log,
+    std::string host,
+    std::string service) {
+  auto certificate = ReadFile(
+      transport_string.GetParamStr(TransportString::kParamCertificate));
+  auto private_key = ReadFile(
+      transport_string.GetParamStr(TransportString::kParamPrivateKey));
+  if (!certificate || !private_key) {
+    log.write(LogSeverity::Warning,
+              "Cannot read the TLS certificate or private key");
+    return ERR_INVALID_ARGUMENT;
+  }
+
+  auto tls_context = CreateServerTlsContext(
+      {.certificate_chain_pem = std::move(*certificate),
+       .private_key_pem = std::move(*private_key)});
+  if (!tls_context.ok()) {
+    log.write(LogSeverity::Warning, "Invalid TLS configuration");
+    return tls_context.error();
+  }
+
+  return any_transport{std::make_unique<PassiveTcpTransport>(
+      executor, log, std::move(host), std::move(service),
+      std::move(*tls_context))};
+}
+
 }  // namespace
 
 std::shared_ptr<TransportFactory> CreateTransportFactory() {
@@ -76,7 +240,8 @@ std::shared_ptr<TransportFactory> CreateTransportFactory() {
 
 // TransportFactoryImpl
 
-TransportFactoryImpl::TransportFactoryImpl() {
+TransportFactoryImpl::TransportFactoryImpl()
+    : message_buffer_pool_{std::make_shared<MessageBufferPool>()} {
   udp_socket_factory_ =
       [](UdpSocketContext&& context) -> std::shared_ptr<UdpSocket> {
     return std::make_shared<UdpSocketImpl>(std::move(context));
@@ -85,6 +250,19 @@ TransportFactoryImpl::TransportFactoryImpl() {
 
 TransportFactoryImpl::~TransportFactoryImpl() = default;
 
+expected<std::shared_ptr<TlsClientContext>>
+TransportFactoryImpl::GetTlsClientContext(
+    const WebSocketClientTlsConfig& config) {
+  std::lock_guard lock{tls_client_contexts_mutex_};
+
+  auto& tls_context = tls_client_contexts_[std::pair{
+      config.verify_peer, config.ca_certificate_pem}];
+  if (!tls_context) {
+    NET_ASSIGN_OR_RETURN(tls_context, TlsClientContext::Create(config));
+  }
+  return tls_context;
+}
+
 expected<any_transport> TransportFactoryImpl::CreateTransport(
     const TransportString& transport_string,
     const executor& executor,
@@ -92,6 +270,23 @@ expected<any_transport> TransportFactoryImpl::CreateTransport(
   log.write(LogSeverity::Normal, "Create transport: {}",
              transport_string.ToString());
 
+  // Splits the stream of the transport created without the framing.
+  if (transport_string.HasParam(TransportString::kParamFraming)) {
+    auto message_reader =
+        CreateFramingMessageReader(transport_string, message_buffer_pool_);
+    if (!message_reader) {
+      log.write(LogSeverity::Warning, "Wrong message framing");
+      return ERR_INVALID_ARGUMENT;
+    }
+
+    auto child_string = transport_string;
+    child_string.RemoveParam(TransportString::kParamFraming);
+    NET_ASSIGN_OR_RETURN(auto child_transport,
+                         CreateTransport(child_string, executor, log));
+    return BindMessageReader(std::move(child_transport),
+                             std::move(message_reader), log);
+  }
+
   auto protocol = transport_string.GetProtocol();
   bool active = transport_string.active();
 
@@ -108,6 +303,27 @@ expected<any_transport> TransportFactoryImpl::CreateTransport(
       return ERR_INVALID_ARGUMENT;
     }
 
+    if (transport_string.HasParam(TransportString::kParamTls) &&
+        transport_string.GetParamInt(TransportString::kParamTls) != 0) {
+      if (!active) {
+        return CreatePassiveTlsTransport(transport_string, executor, log,
+                                         std::string{host},
+                                         std::to_string(port));
+      }
+
+      NET_ASSIGN_OR_RETURN(auto config,
+                           ParseClientTlsConfig(transport_string, log));
+      auto tls_context = GetTlsClientContext(config);
+      if (!tls_context.ok()) {
+        log.write(LogSeverity::Warning, "Invalid TLS configuration");
+        return tls_context.error();
+      }
+
+      return any_transport{std::make_unique<ActiveTlsTransport>(
+          executor, log, std::string{host}, std::to_string(port),
+          std::move(*tls_context), std::move(config.server_name))};
+    }
+
     return active
                ? any_transport{std::make_unique<ActiveTcpTransport>(
                      executor, log, std::string{host}, std::to_string(port))}
@@ -124,12 +340,79 @@ expected<any_transport> TransportFactoryImpl::CreateTransport(
       return ERR_INVALID_ARGUMENT;
     }
 
-    return active ? any_transport{std::make_unique<ActiveUdpTransport>(
-                        executor, log, udp_socket_factory_, std::string{host},
-                        std::to_string(port))}
-                  : any_transport{std::make_unique<PassiveUdpTransport>(
-                        executor, log, udp_socket_factory_, std::string{host},
-                        std::to_string(port))};
+    // UDP;Passive;Port=3000;MaxQueuedDatagrams=256;Overflow=DropOldest
+    UdpTransportOptions options;
+    options.max_queued_datagrams = GetParamSize(
+        transport_string, TransportString::kParamMaxQueuedDatagrams,
+        options.max_queued_datagrams);
+    options.max_queued_bytes =
+        GetParamSize(transport_string, TransportString::kParamMaxQueuedBytes,
+                     options.max_queued_bytes);
+    if (transport_string.HasParam(TransportString::kParamOverflow)) {
+      auto overflow_policy = ParseUdpOverflowPolicy(
+          transport_string.GetParamStr(TransportString::kParamOverflow));
+      if (!overflow_policy) {
+        log.write(LogSeverity::Warning, "Wrong UDP overflow policy");
+        return ERR_INVALID_ARGUMENT;
+      }
+      options.overflow_policy = *overflow_policy;
+    }
+
+    // UDP;Active;Host=239.1.2.3;Port=5000;TTL=8;Loopback=0
+    // UDP;Passive;Host=0.0.0.0;Port=5000;Group=239.1.2.3;Interface=10.0.0.5
+    options.multicast.group =
+        transport_string.GetParamStr(TransportString::kParamGroup);
+    options.multicast.interface_address =
+        transport_string.GetParamStr(TransportString::kParamInterface);
+    if (transport_string.HasParam(TransportString::kParamTtl)) {
+      options.multicast.ttl =
+          transport_string.GetParamInt(TransportString::kParamTtl);
+    }
+    if (transport_string.HasParam(TransportString::kParamLoopback)) {
+      options.multicast.loopback =
+          transport_string.GetParamInt(TransportString::kParamLoopback) != 0;
+    }
+
+    any_transport transport;
+
+    if (active) {
+      transport = any_transport{std::make_unique<ActiveUdpTransport>(
+          executor, log, udp_socket_factory_, std::string{host},
+          std::to_string(port), options)};
+
+    } else {
+      // UDP;Passive;Port=3000;IdleTimeout=30000;MaxPeers=10000
+      options.max_pending_accepts = GetParamSize(
+          transport_string, TransportString::kParamMaxPendingAccepts,
+          options.max_pending_accepts);
+      options.idle_timeout = std::chrono::milliseconds{std::max(
+          0, transport_string.GetParamInt(TransportString::kParamIdleTimeout))};
+      options.max_peers =
+          GetParamSize(transport_string, TransportString::kParamMaxPeers, 0);
+      // UDP;Passive;Port=514;Shards=8
+      options.shard_count = std::max<size_t>(
+          1, GetParamSize(transport_string, TransportString::kParamShards, 1));
+
+      transport = any_transport{std::make_unique<PassiveUdpTransport>(
+          executor, log, udp_socket_factory_, std::string{host},
+          std::to_string(port), options)};
+    }
+
+    // UDP;Active;Host=server;Port=3000;Fragmentation;MTU=1400
+    if (transport_string.HasParam(TransportString::kParamFragmentation)) {
+      FragmentingTransport::Options fragmenting_options;
+      fragmenting_options.mtu =
+          GetParamSize(transport_string, TransportString::kParamMtu,
+                       fragmenting_options.mtu);
+      if (fragmenting_options.mtu <= FragmentingTransport::kHeaderSize) {
+        log.write(LogSeverity::Warning, "UDP MTU is too small");
+        return ERR_INVALID_ARGUMENT;
+      }
+      transport = any_transport{std::make_unique<FragmentingTransport>(
+          std::move(transport), fragmenting_options, log)};
+    }
+
+    return transport;
 
   } else if (protocol == TransportString::SERIAL) {
     // SERIAL;Name=COM2
@@ -197,8 +480,30 @@ expected<any_transport> TransportFactoryImpl::CreateTransport(
       return ERR_INVALID_ARGUMENT;
     }
 
+    // WS;Active;Host=server;Port=8080;Binary;MaxMessageSize=1048576
+    WebSocketServerOptions server_options;
+    WebSocketClientOptions client_options;
+    server_options.binary = client_options.binary =
+        transport_string.HasParam(TransportString::kParamBinary);
+    server_options.max_message_size = client_options.max_message_size =
+        GetParamSize(transport_string, TransportString::kParamMaxMessageSize,
+                     client_options.max_message_size);
+    server_options.max_pending_accepts = GetParamSize(
+        transport_string, TransportString::kParamMaxPendingAccepts,
+        server_options.max_pending_accepts);
+    // WS;Active;Host=server;Port=8080;PingInterval=5000;PongTimeout=15000
+    server_options.keepalive = client_options.keepalive = {
+        .ping_interval = std::chrono::milliseconds{std::max(
+            0,
+            transport_string.GetParamInt(TransportString::kParamPingInterval))},
+        .pong_timeout = std::chrono::milliseconds{std::max(
+            0,
+            transport_string.GetParamInt(TransportString::kParamPongTimeout))},
+    };
+
     return any_transport{std::make_unique<WebSocketTransport>(
-        executor, log, std::string{host}, std::to_string(port), active)};
+        executor, log, std::string{host}, std::to_string(port), active,
+        std::move(server_options), std::move(client_options))};
 
   } else if (protocol == TransportString::INPROCESS) {
     if (!inprocess_transport_host_) {
@@ -5,9 +5,17 @@
 #include "transport/transport_factory.h"
 #include "transport/udp_socket_factory.h"
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
 namespace transport {
 
 class InprocessTransportHost;
+class MessageBufferPool;
+class TlsClientContext;
+struct WebSocketClientTlsConfig;
 
 class TransportFactoryImpl : public TransportFactory {
  public:
@@ -21,8 +29,20 @@ class TransportFactoryImpl : public TransportFactory {
       const log_source& log = {}) override;
 
  private:
+  // Returns the context shared by the transports with the same configuration.
+  [[nodiscard]] expected<std::shared_ptr<TlsClientContext>>
+  GetTlsClientContext(const WebSocketClientTlsConfig& config);
+
   UdpSocketFactory udp_socket_factory_;
   std::unique_ptr<InprocessTransportHost> inprocess_transport_host_;
+  // Shared by the message readers of the created transports.
+  std::shared_ptr<MessageBufferPool> message_buffer_pool_;
+
+  // Client TLS contexts keyed by `verify_peer` and the CA certificate, so that
+  // reconnecting transports resume their sessions.
+  std::mutex tls_client_contexts_mutex_;
+  std::map<std::pair<bool, std::string>, std::shared_ptr<TlsClientContext>>
+      tls_client_contexts_;
 };
 
 std::shared_ptr<TransportFactory> CreateTransportFactory();
@@ -48,6 +48,32 @@ const char* TransportString::kParamByteSize = "ByteSize";
 const char* TransportString::kParamParity = "Parity";
 const char* TransportString::kParamStopBits = "StopBits";
 const char* TransportString::kParamFlowControl = "FlowControl";
+const char* TransportString::kParamIdleTimeout = "IdleTimeout";
+const char* TransportString::kParamMaxPeers = "MaxPeers";
+const char* TransportString::kParamMaxQueuedDatagrams = "MaxQueuedDatagrams";
+const char* TransportString::kParamMaxQueuedBytes = "MaxQueuedBytes";
+const char* TransportString::kParamOverflow = "Overflow";
+const char* TransportString::kParamMaxPendingAccepts = "MaxPendingAccepts";
+const char* TransportString::kParamShards = "Shards";
+const char* TransportString::kParamFragmentation = "Fragmentation";
+const char* TransportString::kParamMtu = "MTU";
+const char* TransportString::kParamGroup = "Group";
+const char* TransportString::kParamInterface = "Interface";
+const char* TransportString::kParamTtl = "TTL";
+const char* TransportString::kParamLoopback = "Loopback";
+const char* TransportString::kParamBinary = "Binary";
+const char* TransportString::kParamMaxMessageSize = "MaxMessageSize";
+const char* TransportString::kParamTls = "TLS";
+const char* TransportString::kParamCertificate = "Certificate";
+const char* TransportString::kParamPrivateKey = "PrivateKey";
+const char* TransportString::kParamCaCertificate = "CaCertificate";
+const char* TransportString::kParamServerName = "ServerName";
+const char* TransportString::kParamVerifyPeer = "VerifyPeer";
+const char* TransportString::kParamPingInterval = "PingInterval";
+const char* TransportString::kParamPongTimeout = "PongTimeout";
+const char* TransportString::kParamFraming = "Framing";
+const char* TransportString::kParamHeaderOffset = "HeaderOffset";
+const char* TransportString::kParamRecordSize = "RecordSize";
 
 const char* TransportString::kParamOrder[] = {
     TransportString::kParamActive, TransportString::kParamPassive,
@@ -60,6 +86,20 @@ const std::string_view TransportString::kFlowControlNone = "No";
 const std::string_view TransportString::kFlowControlSoftware = "XON/XOFF";
 const std::string_view TransportString::kFlowControlHardware = "Hardware";
 
+const std::string_view TransportString::kOverflowDropNewest = "DropNewest";
+const std::string_view TransportString::kOverflowDropOldest = "DropOldest";
+const std::string_view TransportString::kOverflowPauseReading = "PauseReading";
+
+const std::string_view TransportString::kFramingU16Le = "u16le";
+const std::string_view TransportString::kFramingU16Be = "u16be";
+const std::string_view TransportString::kFramingU32Le = "u32le";
+const std::string_view TransportString::kFramingU32Be = "u32be";
+const std::string_view TransportString::kFramingVarint = "varint";
+const std::string_view TransportString::kFramingFixed = "fixed";
+const std::string_view TransportString::kFramingLf = "lf";
+const std::string_view TransportString::kFramingCrLf = "crlf";
+const std::string_view TransportString::kFramingStxEtx = "stxetx";
+
 TransportString::TransportString(std::string_view str) {
   std::string::size_type s = 0;
   while (s < str.length()) {
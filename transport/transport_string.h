@@ -51,6 +51,32 @@ class TransportString {
   static const char* kParamParity;
   static const char* kParamStopBits;
   static const char* kParamFlowControl;
+  static const char* kParamIdleTimeout;
+  static const char* kParamMaxPeers;
+  static const char* kParamMaxQueuedDatagrams;
+  static const char* kParamMaxQueuedBytes;
+  static const char* kParamOverflow;
+  static const char* kParamMaxPendingAccepts;
+  static const char* kParamShards;
+  static const char* kParamFragmentation;
+  static const char* kParamMtu;
+  static const char* kParamGroup;
+  static const char* kParamInterface;
+  static const char* kParamTtl;
+  static const char* kParamLoopback;
+  static const char* kParamBinary;
+  static const char* kParamMaxMessageSize;
+  static const char* kParamTls;
+  static const char* kParamCertificate;
+  static const char* kParamPrivateKey;
+  static const char* kParamCaCertificate;
+  static const char* kParamServerName;
+  static const char* kParamVerifyPeer;
+  static const char* kParamPingInterval;
+  static const char* kParamPongTimeout;
+  static const char* kParamFraming;
+  static const char* kParamHeaderOffset;
+  static const char* kParamRecordSize;
 
   static const char* kParamOrder[];
 
@@ -58,6 +84,20 @@ class TransportString {
   static const std::string_view kFlowControlSoftware;
   static const std::string_view kFlowControlHardware;
 
+  static const std::string_view kOverflowDropNewest;
+  static const std::string_view kOverflowDropOldest;
+  static const std::string_view kOverflowPauseReading;
+
+  static const std::string_view kFramingU16Le;
+  static const std::string_view kFramingU16Be;
+  static const std::string_view kFramingU32Le;
+  static const std::string_view kFramingU32Be;
+  static const std::string_view kFramingVarint;
+  static const std::string_view kFramingFixed;
+  static const std::string_view kFramingLf;
+  static const std::string_view kFramingCrLf;
+  static const std::string_view kFramingStxEtx;
+
  private:
   struct CompareNoCase {
     bool operator()(const std::string& left, const std::string& right) const;
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/asio/ip/udp.hpp>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace transport {
+
+// A UDP endpoint packed into a fixed-size key. IPv4 addresses are stored as
+// IPv4-mapped IPv6 addresses, the port and the IPv6 scope share the last word.
+struct UdpEndpointKey {
+  uint64_t words[3] = {};
+
+  bool operator==(const UdpEndpointKey& other) const {
+    return words[0] == other.words[0] && words[1] == other.words[1] &&
+           words[2] == other.words[2];
+  }
+};
+
+inline UdpEndpointKey MakeUdpEndpointKey(
+    const boost::asio::ip::udp::endpoint& endpoint) {
+  using boost::asio::ip::address_v6;
+
+  const auto address = endpoint.address();
+
+  address_v6::bytes_type bytes;
+  uint32_t scope_id = 0;
+  if (address.is_v4()) {
+    bytes = boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped,
+                                             address.to_v4())
+                .to_bytes();
+  } else {
+    const auto address6 = address.to_v6();
+    bytes = address6.to_bytes();
+    scope_id = static_cast<uint32_t>(address6.scope_id());
+  }
+
+  UdpEndpointKey key;
+  static_assert(sizeof(bytes) == 2 * sizeof(uint64_t));
+  std::memcpy(key.words, bytes.data(), bytes.size());
+  key.words[2] = uint64_t{endpoint.port()} | (uint64_t{scope_id} << 16);
+  return key;
+}
+
+// An open-addressing hash table keyed by `UdpEndpointKey`. Slots are stored
+// inline in a single array and collisions are resolved by linear probing, so
+// a lookup usually touches a single cache line. Erasure shifts the following
+// entries back and doesn't leave tombstones.
+template <class Value>
+class UdpEndpointTable {
+ public:
+  UdpEndpointTable() = default;
+
+  UdpEndpointTable(const UdpEndpointTable&) = delete;
+  UdpEndpointTable& operator=(const UdpEndpointTable&) = delete;
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // Returns nullptr if there is no such key.
+  Value* Find(const UdpEndpointKey& key);
+
+  // Returns nullptr if the key is already present.
+  Value* Insert(const UdpEndpointKey& key, Value value);
+
+  // Returns false if there is no such key.
+  bool Erase(const UdpEndpointKey& key);
+
+  void Clear();
+
+  // Calls `callback(key, value)` for each entry. The table must not be
+  // modified from the callback.
+  template <class Callback>
+  void ForEach(Callback&& callback);
+
+ private:
+  static constexpr size_t kMinCapacity = 16;
+
+  struct Slot {
+    UdpEndpointKey key;
+    Value value{};
+    bool occupied = false;
+  };
+
+  static size_t Hash(const UdpEndpointKey& key);
+
+  size_t HomeIndex(const UdpEndpointKey& key) const {
+    return Hash(key) & (slots_.size() - 1);
+  }
+
+  // Returns the slot index of the key or of the empty slot where it would be
+  // inserted.
+  size_t Probe(const UdpEndpointKey& key) const;
+
+  void Rehash(size_t capacity);
+
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+};
+
+template <class Value>
+inline size_t UdpEndpointTable<Value>::Hash(const UdpEndpointKey& key) {
+  // Fold the words and finalize with the SplitMix64 mixer.
+  uint64_t h = key.words[0] ^ (key.words[1] * 0x9e3779b97f4a7c15ull) ^
+               (key.words[2] * 0xc2b2ae3d27d4eb4full);
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return static_cast<size_t>(h);
+}
+
+template <class Value>
+inline size_t UdpEndpointTable<Value>::Probe(const UdpEndpointKey& key) const {
+  assert(!slots_.empty());
+
+  const size_t mask = slots_.size() - 1;
+  size_t index = HomeIndex(key);
+  while (slots_[index].occupied && !(slots_[index].key == key)) {
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+template <class Value>
+inline Value* UdpEndpointTable<Value>::Find(const UdpEndpointKey& key) {
+  if (size_ == 0) {
+    return nullptr;
+  }
+
+  auto& slot = slots_[Probe(key)];
+  return slot.occupied ? &slot.value : nullptr;
+}
+
+template <class Value>
+inline Value* UdpEndpointTable<Value>::Insert(const UdpEndpointKey& key,
+                                              Value value) {
+  // Keep the load factor at or below one half.
+  if ((size_ + 1) * 2 > slots_.size()) {
+    Rehash(std::max(kMinCapacity, slots_.size() * 2));
+  }
+
+  auto& slot = slots_[Probe(key)];
+  if (slot.occupied) {
+    return nullptr;
+  }
+
+  slot.key = key;
+  slot.value = std::move(value);
+  slot.occupied = true;
+  ++size_;
+  return &slot.value;
+}
+
+template <class Value>
+inline bool UdpEndpointTable<Value>::Erase(const UdpEndpointKey& key) {
+  if (size_ == 0) {
+    return false;
+  }
+
+  size_t hole = Probe(key);
+  if (!slots_[hole].occupied) {
+    return false;
+  }
+
+  slots_[hole] = Slot{};
+  --size_;
+
+  // Shift back the entries of the probe sequence that follows the hole, unless
+  // an entry's home index lies cyclically within (hole, index].
+  const size_t mask = slots_.size() - 1;
+  for (size_t index = (hole + 1) & mask; slots_[index].occupied;
+       index = (index + 1) & mask) {
+    const size_t home = HomeIndex(slots_[index].key);
+    const bool stays = hole <= index ? (hole < home && home <= index)
+                                     : (hole < home || home <= index);
+    if (stays) {
+      continue;
+    }
+
+    slots_[hole] = std::move(slots_[index]);
+    slots_[index] = Slot{};
+    hole = index;
+  }
+
+  return true;
+}
+
+template <class Value>
+inline void UdpEndpointTable<Value>::Clear() {
+  slots_.clear();
+  size_ = 0;
+}
+
+template <class Value>
+template <class Callback>
+inline void UdpEndpointTable<Value>::ForEach(Callback&& callback) {
+  for (auto& slot : slots_) {
+    if (slot.occupied) {
+      callback(static_cast<const UdpEndpointKey&>(slot.key), slot.value);
+    }
+  }
+}
+
+template <class Value>
+inline void UdpEndpointTable<Value>::Rehash(size_t capacity) {
+  assert((capacity & (capacity - 1)) == 0);
+
+  auto old_slots = std::exchange(slots_, std::vector<Slot>(capacity));
+  for (auto& slot : old_slots) {
+    if (slot.occupied) {
+      auto& new_slot = slots_[Probe(slot.key)];
+      new_slot.key = slot.key;
+      new_slot.value = std::move(slot.value);
+      new_slot.occupied = true;
+    }
+  }
+}
+
+}  // namespace transport
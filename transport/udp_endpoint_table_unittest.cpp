@@ -0,0 +1,82 @@
+#include "transport/udp_endpoint_table.h"
+
+#include <gmock/gmock.h>
+
+#include <map>
+#include <random>
+
+namespace transport {
+
+namespace {
+
+using boost::asio::ip::make_address;
+using boost::asio::ip::udp;
+
+UdpEndpointKey MakeKey(const char* address, unsigned short port) {
+  return MakeUdpEndpointKey(udp::endpoint{make_address(address), port});
+}
+
+}  // namespace
+
+TEST(UdpEndpointKey, DistinguishesAddressAndPort) {
+  EXPECT_EQ(MakeKey("10.0.0.1", 1000), MakeKey("10.0.0.1", 1000));
+  EXPECT_FALSE(MakeKey("10.0.0.1", 1000) == MakeKey("10.0.0.1", 1001));
+  EXPECT_FALSE(MakeKey("10.0.0.1", 1000) == MakeKey("10.0.0.2", 1000));
+  EXPECT_FALSE(MakeKey("10.0.0.1", 1000) == MakeKey("::1", 1000));
+}
+
+TEST(UdpEndpointKey, MapsIPv4ToIPv6) {
+  EXPECT_EQ(MakeKey("10.0.0.1", 1000), MakeKey("::ffff:10.0.0.1", 1000));
+}
+
+TEST(UdpEndpointTable, InsertFindErase) {
+  UdpEndpointTable<int> table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(table.Find(MakeKey("127.0.0.1", 1)), nullptr);
+
+  ASSERT_NE(table.Insert(MakeKey("127.0.0.1", 1), 10), nullptr);
+  ASSERT_NE(table.Insert(MakeKey("127.0.0.1", 2), 20), nullptr);
+  EXPECT_EQ(table.Insert(MakeKey("127.0.0.1", 1), 30), nullptr);
+  EXPECT_EQ(table.size(), 2u);
+
+  ASSERT_NE(table.Find(MakeKey("127.0.0.1", 1)), nullptr);
+  EXPECT_EQ(*table.Find(MakeKey("127.0.0.1", 1)), 10);
+
+  EXPECT_TRUE(table.Erase(MakeKey("127.0.0.1", 1)));
+  EXPECT_FALSE(table.Erase(MakeKey("127.0.0.1", 1)));
+  EXPECT_EQ(table.Find(MakeKey("127.0.0.1", 1)), nullptr);
+  ASSERT_NE(table.Find(MakeKey("127.0.0.1", 2)), nullptr);
+  EXPECT_EQ(*table.Find(MakeKey("127.0.0.1", 2)), 20);
+  EXPECT_EQ(table.size(), 1u);
+}
+
+TEST(UdpEndpointTable, MatchesReferenceMap) {
+  UdpEndpointTable<int> table;
+  std::map<unsigned short, int> reference;
+
+  std::mt19937 random{42};
+  std::uniform_int_distribution<int> port_distribution{1, 2000};
+
+  for (int i = 0; i < 100000; ++i) {
+    const auto port = static_cast<unsigned short>(port_distribution(random));
+    const auto key = MakeKey("192.168.0.1", port);
+    if (random() % 3 == 0) {
+      EXPECT_EQ(table.Erase(key), reference.erase(port) != 0);
+    } else {
+      const bool inserted = table.Insert(key, i) != nullptr;
+      EXPECT_EQ(inserted, reference.emplace(port, i).second);
+    }
+  }
+
+  EXPECT_EQ(table.size(), reference.size());
+  for (unsigned short port = 1; port <= 2000; ++port) {
+    auto* value = table.Find(MakeKey("192.168.0.1", port));
+    auto i = reference.find(port);
+    ASSERT_EQ(value != nullptr, i != reference.end());
+    if (value) {
+      EXPECT_EQ(*value, i->second);
+    }
+  }
+}
+
+}  // namespace transport
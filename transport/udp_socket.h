@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <optional>
 #include <vector>
 
 namespace transport {
@@ -23,9 +24,29 @@ class UdpSocket {
       Endpoint endpoint,
       std::span<const char> datagram) = 0;
 
+  // Stops delivering received datagrams until `ResumeReading`. Datagrams
+  // arriving meanwhile wait in the OS socket buffer, which drops them once it
+  // is full.
+  virtual void PauseReading() = 0;
+  virtual void ResumeReading() = 0;
+
   virtual void Shutdown() = 0;
 };
 
+// IP multicast settings of a socket.
+struct UdpMulticastOptions {
+  // Passive sockets only. The group to join after binding. Datagrams sent to
+  // the group arrive from the sender's endpoint.
+  std::string group;
+  // The local IPv4 address of the interface to join the group and send on.
+  // Empty selects the default interface. IPv6 groups use their scope ID.
+  std::string interface_address;
+  // The hop limit (TTL) of sent multicast datagrams. The OS default is 1.
+  std::optional<int> ttl;
+  // Whether sent multicast datagrams are delivered back to the local host.
+  std::optional<bool> loopback;
+};
+
 struct UdpSocketContext {
   const executor executor_;
   const std::string host_;
@@ -35,12 +56,25 @@ struct UdpSocketContext {
   using OpenHandler = std::function<void(const UdpSocket::Endpoint& endpoint)>;
   const OpenHandler open_handler_;
 
-  using MessageHandler = std::function<void(const UdpSocket::Endpoint& endpoint,
-                                            UdpSocket::Datagram&& datagram)>;
+  // `timestamp` is the kernel receive time, if the OS provides it.
+  using MessageHandler = std::function<void(
+      const UdpSocket::Endpoint& endpoint,
+      UdpSocket::Datagram&& datagram,
+      std::optional<ReceiveTimestamp> timestamp)>;
   const MessageHandler message_handler_;
 
   using ErrorHandler = std::function<void(const UdpSocket::error_code& error)>;
   const ErrorHandler error_handler_;
+
+  // Active sockets only. Receives errors the peer reports via ICMP, like an
+  // unreachable port. The socket remains open.
+  const ErrorHandler read_error_handler_;
+
+  // Passive sockets only. Allows several sockets to bind the same address,
+  // with the OS balancing peers across them (`SO_REUSEPORT`).
+  const bool reuse_port_ = false;
+
+  const UdpMulticastOptions multicast_;
 };
 
 }  // namespace transport
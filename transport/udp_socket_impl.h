@@ -1,9 +1,26 @@
 #pragma once
 
+#include "transport/receive_timestamp.h"
 #include "transport/udp_socket.h"
 
+#include <cstring>
+#include <deque>
 #include <memory>
-#include <queue>
+#include <tuple>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
 
 namespace transport {
 
@@ -21,12 +38,72 @@ class UdpSocketImpl final : private UdpSocketContext,
       Endpoint endpoint,
       std::span<const char> datagram) override;
 
+  virtual void PauseReading() override;
+  virtual void ResumeReading() override;
+
   virtual void Shutdown() override;
 
+  // The number of batches sent with segmentation offload.
+  size_t segmented_send_count() const { return segmented_send_count_; }
+
+  // Whether the kernel accepts segmentation offload sends. Cleared if a send
+  // fails with it.
+  bool gso_enabled() const { return gso_enabled_; }
+
+  // Whether reads report kernel receive timestamps.
+  bool timestamps_enabled() const { return timestamps_enabled_; }
+
  private:
+  // Limits of a single segmentation offload (GSO) send. The kernel accepts up
+  // to 64 segments per call and the whole batch must fit a single UDP
+  // datagram.
+  static constexpr size_t kMaxSegmentCount = 64;
+  static constexpr size_t kMaxSegmentedBytes = 65000;
+
   [[nodiscard]] awaitable<void> StartReading();
   [[nodiscard]] awaitable<void> StartWriting();
 
+  // Returns the error, the number of bytes received and the GRO segment size.
+  // The segment size is zero when the received buffer is a single datagram.
+  [[nodiscard]] awaitable<std::tuple<error_code, size_t, size_t>> Receive();
+
+  // Splits a GRO-coalesced buffer back into individual datagrams.
+  void DispatchDatagrams(size_t bytes_received, size_t segment_size);
+
+  // Moves the next run of equal-size datagrams addressed to the same endpoint
+  // into `write_buffer_`. Only the last datagram of the run may be shorter.
+  // Returns the segment size, or zero when a single datagram is taken.
+  size_t TakeWriteBatch();
+
+  [[nodiscard]] awaitable<error_code> SendBatch(size_t segment_size);
+
+  void EnableSegmentationOffload();
+  void EnableReceiveTimestamps();
+
+  // Multicast settings. The send settings must be applied before `connect`,
+  // which fixes the route of an active socket.
+  boost::asio::ip::address_v4 GetMulticastInterface(error_code& ec) const;
+  error_code SetMulticastSendOptions();
+  error_code JoinMulticastGroup();
+
+#if defined(__linux__)
+  error_code ReceiveMessage(size_t& bytes_received, size_t& segment_size);
+  error_code SendSegmentedMessage(size_t segment_size);
+#endif
+
+  // Sends the datagram right away if the socket buffer has room. Returns
+  // `would_block` otherwise.
+  error_code TrySend(const Endpoint& endpoint, std::span<const char> datagram);
+
+  // Queues further datagrams until the executor runs other handlers, so a
+  // burst after a direct send still forms a segmentation offload batch.
+  void CorkWrites();
+
+  // Errors a connected socket reports for ICMP messages from the peer. They
+  // don't invalidate the socket.
+  static bool IsPeerUnreachableError(const error_code& error);
+  void ReportReadError(const error_code& error);
+
   void ProcessError(const boost::system::error_code& ec);
 
   Resolver resolver_{executor_};
@@ -35,14 +112,25 @@ class UdpSocketImpl final : private UdpSocketContext,
   bool connected_ = false;
   bool closed_ = false;
 
+  // Segmentation offload is only available on Linux and is probed per socket.
+  bool gso_enabled_ = false;
+  bool gro_enabled_ = false;
+
+  // Kernel receive timestamps (`SO_TIMESTAMPNS`) are only read on Linux.
+  bool timestamps_enabled_ = false;
+
   Datagram read_buffer_;
   Endpoint read_endpoint_;
+  std::optional<ReceiveTimestamp> read_timestamp_;
   bool reading_ = false;
+  bool read_paused_ = false;
 
-  std::queue<std::pair<Endpoint, Datagram>> write_queue_;
+  std::deque<std::pair<Endpoint, Datagram>> write_queue_;
   Datagram write_buffer_;
   Endpoint write_endpoint_;
   bool writing_ = false;
+  bool write_corked_ = false;
+  size_t segmented_send_count_ = 0;
 };
 
 inline UdpSocketImpl::UdpSocketImpl(UdpSocketContext&& context)
@@ -81,11 +169,35 @@ inline awaitable<error_code> UdpSocketImpl::Open() {
 
     last_endpoint = it;
 
+    ec = SetMulticastSendOptions();
+    if (ec) {
+      socket_.close();
+      continue;
+    }
+
+    // An active socket is connected, so the kernel filters out datagrams from
+    // other peers and reports ICMP errors.
     if (active_) {
-      break;
+      socket_.connect(it->endpoint(), ec);
+      if (!ec) {
+        read_endpoint_ = it->endpoint();
+        break;
+      }
+
+      socket_.close();
+      continue;
     }
 
     socket_.set_option(Socket::reuse_address{true}, ec);
+
+#if defined(SO_REUSEPORT)
+    if (reuse_port_) {
+      using reuse_port =
+          boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+      socket_.set_option(reuse_port{true}, ec);
+    }
+#endif
+
     socket_.bind(it->endpoint(), ec);
     if (!ec) {
       break;
@@ -94,18 +206,28 @@ inline awaitable<error_code> UdpSocketImpl::Open() {
     socket_.close();
   }
 
+  if (!ec && !multicast_.group.empty()) {
+    ec = JoinMulticastGroup();
+  }
+
   if (ec) {
     ProcessError(ec);
     co_return ec;
   }
 
+  // Allows `TrySend`. Asynchronous operations are not affected.
+  socket_.non_blocking(true, ec);
+
+  EnableSegmentationOffload();
+  EnableReceiveTimestamps();
+
   connected_ = true;
   open_handler_(last_endpoint->endpoint());
 
-  if (!active_) {
-    boost::asio::co_spawn(socket_.get_executor(), StartReading(),
-                          boost::asio::detached);
-  }
+  // Reading starts right away, so replies that arrive before the first write
+  // are not lost.
+  boost::asio::co_spawn(socket_.get_executor(), StartReading(),
+                        boost::asio::detached);
 
   co_return OK;
 }
@@ -129,52 +251,198 @@ inline awaitable<expected<size_t>> UdpSocketImpl::SendTo(
     std::span<const char> datagram) {
   auto size = datagram.size();
 
-  write_queue_.emplace(std::piecewise_construct,
-                       std::forward_as_tuple(std::move(endpoint)),
-                       std::forward_as_tuple(datagram.begin(), datagram.end()));
+  // Keep the order of queued datagrams.
+  if (connected_ && !writing_ && !write_corked_ && write_queue_.empty()) {
+    auto error = TrySend(endpoint, datagram);
+    if (!error) {
+      CorkWrites();
+      co_return size;
+    }
 
-  boost::asio::co_spawn(socket_.get_executor(), StartWriting(),
-                        boost::asio::detached);
+    if (error != boost::asio::error::would_block) {
+      ProcessError(error);
+      co_return error;
+    }
+  }
+
+  write_queue_.emplace_back(std::piecewise_construct,
+                            std::forward_as_tuple(std::move(endpoint)),
+                            std::forward_as_tuple(datagram.begin(),
+                                                  datagram.end()));
+
+  if (!writing_) {
+    boost::asio::co_spawn(socket_.get_executor(), StartWriting(),
+                          boost::asio::detached);
+  }
 
   // TODO: Proper async operation.
   co_return size;
 }
 
+inline UdpSocket::error_code UdpSocketImpl::TrySend(
+    const Endpoint& endpoint,
+    std::span<const char> datagram) {
+  for (;;) {
+    error_code error;
+    if (active_) {
+      socket_.send(boost::asio::buffer(datagram.data(), datagram.size()), 0,
+                   error);
+    } else {
+      socket_.send_to(boost::asio::buffer(datagram.data(), datagram.size()),
+                      endpoint, 0, error);
+    }
+
+    // A pending ICMP error fails the send. Report it and retry.
+    if (!active_ || !IsPeerUnreachableError(error)) {
+      return error;
+    }
+
+    ReportReadError(error);
+  }
+}
+
+inline void UdpSocketImpl::CorkWrites() {
+  if (!gso_enabled_ || write_corked_) {
+    return;
+  }
+
+  write_corked_ = true;
+
+  // Runs ahead of the writer started for the datagrams queued meanwhile.
+  boost::asio::post(socket_.get_executor(), [weak_ptr = weak_from_this()] {
+    if (auto ref = weak_ptr.lock())
+      ref->write_corked_ = false;
+  });
+}
+
+inline void UdpSocketImpl::ReportReadError(const error_code& error) {
+  if (read_error_handler_) {
+    read_error_handler_(error);
+  }
+}
+
+inline bool UdpSocketImpl::IsPeerUnreachableError(const error_code& error) {
+  return error == boost::asio::error::connection_refused ||
+         // Windows reports an unreachable port as a reset.
+         error == boost::asio::error::connection_reset ||
+         error == boost::asio::error::host_unreachable ||
+         error == boost::asio::error::network_unreachable;
+}
+
+inline void UdpSocketImpl::PauseReading() {
+  read_paused_ = true;
+}
+
+inline void UdpSocketImpl::ResumeReading() {
+  if (!read_paused_) {
+    return;
+  }
+
+  read_paused_ = false;
+
+  if (connected_ && !reading_) {
+    boost::asio::co_spawn(socket_.get_executor(), StartReading(),
+                          boost::asio::detached);
+  }
+}
+
 inline awaitable<void> UdpSocketImpl::StartReading() {
   if (closed_) {
     co_return;
   }
 
-  if (reading_) {
+  if (reading_ || read_paused_) {
     co_return;
   }
 
   auto ref = shared_from_this();
 
-  for (;;) {
-    reading_ = true;
-
-    auto [error, bytes_transferred] = co_await socket_.async_receive_from(
-        boost::asio::buffer(read_buffer_), read_endpoint_,
-        boost::asio::as_tuple(boost::asio::use_awaitable));
+  // The read loop keeps `reading_` set until it exits, so that a resume
+  // requested from the message handler doesn't start a second loop.
+  reading_ = true;
 
-    reading_ = false;
+  while (!read_paused_) {
+    auto [error, bytes_transferred, segment_size] = co_await Receive();
 
     if (closed_) {
       co_return;
     }
 
+    if (active_ && IsPeerUnreachableError(error)) {
+      ReportReadError(error);
+      continue;
+    }
+
     if (error) {
+      reading_ = false;
       ProcessError(error);
       co_return;
     }
 
-    assert(bytes_transferred != 0);
+    DispatchDatagrams(bytes_transferred, segment_size);
+
+    if (closed_) {
+      co_return;
+    }
+  }
+
+  reading_ = false;
+}
+
+inline awaitable<std::tuple<UdpSocket::error_code, size_t, size_t>>
+UdpSocketImpl::Receive() {
+#if defined(__linux__)
+  // Control messages carrying the GRO segment size and the timestamp are only
+  // available from `recvmsg`.
+  if (gro_enabled_ || timestamps_enabled_) {
+    for (;;) {
+      size_t bytes_received = 0;
+      size_t segment_size = 0;
+      auto error = ReceiveMessage(bytes_received, segment_size);
+      if (error != boost::asio::error::would_block) {
+        co_return std::make_tuple(error, bytes_received, segment_size);
+      }
+
+      auto [wait_error] = co_await socket_.async_wait(
+          Socket::wait_read, boost::asio::as_tuple(boost::asio::use_awaitable));
+
+      if (wait_error || closed_) {
+        co_return std::make_tuple(wait_error, size_t{0}, size_t{0});
+      }
+    }
+  }
+#endif
+
+  read_timestamp_.reset();
+
+  // A connected socket keeps the peer in `read_endpoint_`.
+  auto [error, bytes_transferred] =
+      active_ ? co_await socket_.async_receive(
+                    boost::asio::buffer(read_buffer_),
+                    boost::asio::as_tuple(boost::asio::use_awaitable))
+              : co_await socket_.async_receive_from(
+                    boost::asio::buffer(read_buffer_), read_endpoint_,
+                    boost::asio::as_tuple(boost::asio::use_awaitable));
 
-    std::vector<char> datagram(read_buffer_.begin(),
-                               read_buffer_.begin() + bytes_transferred);
+  co_return std::make_tuple(error, bytes_transferred, size_t{0});
+}
+
+inline void UdpSocketImpl::DispatchDatagrams(size_t bytes_received,
+                                             size_t segment_size) {
+  if (segment_size == 0 || segment_size >= bytes_received) {
+    message_handler_(read_endpoint_,
+                     Datagram(read_buffer_.begin(),
+                              read_buffer_.begin() + bytes_received),
+                     read_timestamp_);
+    return;
+  }
 
-    message_handler_(read_endpoint_, std::move(datagram));
+  for (size_t offset = 0; offset < bytes_received && !closed_;
+       offset += segment_size) {
+    auto size = std::min(segment_size, bytes_received - offset);
+    auto begin = read_buffer_.begin() + offset;
+    message_handler_(read_endpoint_, Datagram(begin, begin + size),
+                     read_timestamp_);
   }
 }
 
@@ -192,15 +460,8 @@ inline awaitable<void> UdpSocketImpl::StartWriting() {
   while (!write_queue_.empty()) {
     writing_ = true;
 
-    auto [endpoint, datagram] = std::move(write_queue_.front());
-    write_queue_.pop();
-
-    write_endpoint_ = endpoint;
-    write_buffer_ = std::move(datagram);
-
-    auto [error, bytes_transferred] = co_await socket_.async_send_to(
-        boost::asio::buffer(write_buffer_), write_endpoint_,
-        boost::asio::as_tuple(boost::asio::use_awaitable));
+    auto segment_size = TakeWriteBatch();
+    auto error = co_await SendBatch(segment_size);
 
     if (closed_) {
       co_return;
@@ -208,18 +469,272 @@ inline awaitable<void> UdpSocketImpl::StartWriting() {
 
     writing_ = false;
     write_buffer_.clear();
-    write_buffer_.shrink_to_fit();
+
+    if (active_ && IsPeerUnreachableError(error)) {
+      ReportReadError(error);
+      continue;
+    }
 
     if (error) {
       ProcessError(error);
       co_return;
     }
+  }
+}
 
-    boost::asio::co_spawn(socket_.get_executor(), StartReading(),
-                          boost::asio::detached);
+inline size_t UdpSocketImpl::TakeWriteBatch() {
+  assert(!write_queue_.empty());
+
+  {
+    auto& [endpoint, datagram] = write_queue_.front();
+    write_endpoint_ = std::move(endpoint);
+    write_buffer_ = std::move(datagram);
+    write_queue_.pop_front();
+  }
+
+  const size_t segment_size = write_buffer_.size();
+  if (!gso_enabled_ || segment_size == 0 || write_queue_.empty()) {
+    return 0;
   }
+
+  size_t segment_count = 1;
+  while (!write_queue_.empty() && segment_count < kMaxSegmentCount) {
+    const auto& [endpoint, datagram] = write_queue_.front();
+    if (endpoint != write_endpoint_ || datagram.empty() ||
+        datagram.size() > segment_size ||
+        write_buffer_.size() + datagram.size() > kMaxSegmentedBytes) {
+      break;
+    }
+
+    const bool last = datagram.size() < segment_size;
+    write_buffer_.insert(write_buffer_.end(), datagram.begin(),
+                         datagram.end());
+    write_queue_.pop_front();
+    ++segment_count;
+
+    if (last) {
+      break;
+    }
+  }
+
+  return segment_count > 1 ? segment_size : 0;
+}
+
+inline awaitable<UdpSocket::error_code> UdpSocketImpl::SendBatch(
+    size_t segment_size) {
+#if defined(__linux__)
+  if (segment_size != 0) {
+    for (;;) {
+      auto error = SendSegmentedMessage(segment_size);
+      if (!error) {
+        ++segmented_send_count_;
+        co_return error;
+      }
+
+      if (error != boost::asio::error::would_block) {
+        if (error == boost::asio::error::no_protocol_option ||
+            error == boost::system::errc::io_error) {
+          // The route or the device doesn't support segmentation offload.
+          gso_enabled_ = false;
+        } else if (error != boost::asio::error::invalid_argument) {
+          co_return error;
+        }
+        // Fall back to sending the segments one by one.
+        break;
+      }
+
+      auto [wait_error] = co_await socket_.async_wait(
+          Socket::wait_write,
+          boost::asio::as_tuple(boost::asio::use_awaitable));
+
+      if (wait_error || closed_) {
+        co_return wait_error;
+      }
+    }
+  }
+#endif
+
+  const size_t step = segment_size != 0 ? segment_size : write_buffer_.size();
+  size_t offset = 0;
+  do {
+    auto size = std::min(step, write_buffer_.size() - offset);
+
+    auto buffer = boost::asio::buffer(write_buffer_.data() + offset, size);
+    auto [error, bytes_transferred] =
+        active_ ? co_await socket_.async_send(
+                      buffer, boost::asio::as_tuple(boost::asio::use_awaitable))
+                : co_await socket_.async_send_to(
+                      buffer, write_endpoint_,
+                      boost::asio::as_tuple(boost::asio::use_awaitable));
+
+    if (error || closed_) {
+      co_return error;
+    }
+
+    offset += size;
+  } while (offset < write_buffer_.size());
+
+  co_return error_code{};
+}
+
+inline void UdpSocketImpl::EnableSegmentationOffload() {
+#if defined(__linux__)
+  const auto handle = socket_.native_handle();
+
+  int gso_size = 0;
+  socklen_t gso_size_length = sizeof(gso_size);
+  gso_enabled_ = ::getsockopt(handle, IPPROTO_UDP, UDP_SEGMENT, &gso_size,
+                              &gso_size_length) == 0;
+
+  int gro = 1;
+  gro_enabled_ =
+      ::setsockopt(handle, IPPROTO_UDP, UDP_GRO, &gro, sizeof(gro)) == 0;
+#endif
+}
+
+inline void UdpSocketImpl::EnableReceiveTimestamps() {
+#if defined(__linux__)
+  timestamps_enabled_ = transport::EnableReceiveTimestamps(
+      socket_.native_handle());
+#endif
 }
 
+inline boost::asio::ip::address_v4 UdpSocketImpl::GetMulticastInterface(
+    error_code& ec) const {
+  if (multicast_.interface_address.empty()) {
+    return boost::asio::ip::address_v4::any();
+  }
+  return boost::asio::ip::make_address_v4(multicast_.interface_address, ec);
+}
+
+inline UdpSocket::error_code UdpSocketImpl::SetMulticastSendOptions() {
+  namespace multicast = boost::asio::ip::multicast;
+
+  error_code ec;
+
+  if (multicast_.ttl) {
+    socket_.set_option(multicast::hops{*multicast_.ttl}, ec);
+    if (ec) {
+      return ec;
+    }
+  }
+
+  if (multicast_.loopback) {
+    socket_.set_option(multicast::enable_loopback{*multicast_.loopback}, ec);
+    if (ec) {
+      return ec;
+    }
+  }
+
+  auto interface_address = GetMulticastInterface(ec);
+  if (!ec && !interface_address.is_unspecified()) {
+    socket_.set_option(multicast::outbound_interface{interface_address}, ec);
+  }
+
+  return ec;
+}
+
+inline UdpSocket::error_code UdpSocketImpl::JoinMulticastGroup() {
+  namespace multicast = boost::asio::ip::multicast;
+
+  error_code ec;
+
+  auto group = boost::asio::ip::make_address(multicast_.group, ec);
+  if (ec) {
+    return ec;
+  }
+
+  if (group.is_v6()) {
+    // The scope ID of the group selects the interface.
+    socket_.set_option(multicast::join_group{group.to_v6()}, ec);
+    return ec;
+  }
+
+  auto interface_address = GetMulticastInterface(ec);
+  if (!ec) {
+    socket_.set_option(multicast::join_group{group.to_v4(), interface_address},
+                       ec);
+  }
+
+  return ec;
+}
+
+#if defined(__linux__)
+
+inline UdpSocket::error_code UdpSocketImpl::ReceiveMessage(
+    size_t& bytes_received,
+    size_t& segment_size) {
+  sockaddr_storage address = {};
+  iovec iov = {read_buffer_.data(), read_buffer_.size()};
+  alignas(cmsghdr) char
+      control[CMSG_SPACE(sizeof(int)) + kReceiveTimestampControlSize] = {};
+
+  msghdr message = {};
+  message.msg_name = &address;
+  message.msg_namelen = sizeof(address);
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  auto result = ::recvmsg(socket_.native_handle(), &message, MSG_DONTWAIT);
+  if (result < 0) {
+    return error_code{errno, boost::asio::error::get_system_category()};
+  }
+
+  bytes_received = static_cast<size_t>(result);
+  segment_size = 0;
+  read_timestamp_.reset();
+
+  for (auto* header = CMSG_FIRSTHDR(&message); header;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level == IPPROTO_UDP && header->cmsg_type == UDP_GRO) {
+      int gro_size = 0;
+      std::memcpy(&gro_size, CMSG_DATA(header), sizeof(gro_size));
+      segment_size = static_cast<size_t>(gro_size);
+    } else if (auto timestamp = GetReceiveTimestamp(*header)) {
+      read_timestamp_ = timestamp;
+    }
+  }
+
+  std::memcpy(read_endpoint_.data(), &address, message.msg_namelen);
+  read_endpoint_.resize(message.msg_namelen);
+
+  return error_code{};
+}
+
+inline UdpSocket::error_code UdpSocketImpl::SendSegmentedMessage(
+    size_t segment_size) {
+  iovec iov = {write_buffer_.data(), write_buffer_.size()};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+  // A connected socket must not be given a destination.
+  msghdr message = {};
+  if (!active_) {
+    message.msg_name = write_endpoint_.data();
+    message.msg_namelen = static_cast<socklen_t>(write_endpoint_.size());
+  }
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  auto* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = IPPROTO_UDP;
+  header->cmsg_type = UDP_SEGMENT;
+  header->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  const auto gso_size = static_cast<uint16_t>(segment_size);
+  std::memcpy(CMSG_DATA(header), &gso_size, sizeof(gso_size));
+
+  if (::sendmsg(socket_.native_handle(), &message, MSG_DONTWAIT) < 0) {
+    return error_code{errno, boost::asio::error::get_system_category()};
+  }
+
+  return error_code{};
+}
+
+#endif  // defined(__linux__)
+
 inline void UdpSocketImpl::ProcessError(const boost::system::error_code& ec) {
   connected_ = false;
   closed_ = true;
@@ -2,12 +2,19 @@
 
 #include "transport/any_transport.h"
 #include "transport/log.h"
+#include "transport/timer.h"
+#include "transport/timer_wheel.h"
+#include "transport/udp_endpoint_table.h"
 #include "transport/udp_socket_impl.h"
 
 #include <boost/asio/as_tuple.hpp>
+#include <atomic>
 #include <boost/asio/experimental/channel.hpp>
-#include <map>
+#include <boost/asio/strand.hpp>
+#include <deque>
+#include <functional>
 #include <ranges>
+#include <utility>
 
 std::string ToString(const transport::UdpSocket::Endpoint& endpoint) {
   std::stringstream stream;
@@ -17,6 +24,212 @@ std::string ToString(const transport::UdpSocket::Endpoint& endpoint) {
 
 namespace transport {
 
+namespace {
+
+// Shared by a passive transport and its accepted transports, which may run on
+// different executors.
+struct UdpTransportCounters {
+  UdpTransportStats GetStats() const {
+    return {.dropped_datagrams = dropped_datagrams.load(),
+            .dropped_bytes = dropped_bytes.load(),
+            .dropped_peer_datagrams = dropped_peer_datagrams.load(),
+            .read_pauses = read_pauses.load()};
+  }
+
+  std::atomic<uint64_t> dropped_datagrams = 0;
+  std::atomic<uint64_t> dropped_bytes = 0;
+  std::atomic<uint64_t> dropped_peer_datagrams = 0;
+  std::atomic<uint64_t> read_pauses = 0;
+};
+
+struct ReceivedDatagram {
+  UdpSocket::Datagram data;
+  std::optional<ReceiveTimestamp> timestamp;
+};
+
+// Received datagrams of a transport, bounded as configured by
+// `UdpTransportOptions`. The reader waits for a notification and takes
+// datagrams from the queue, so the oldest datagrams can be dropped.
+class UdpReceiveQueue {
+ public:
+  // Called with `true` when reading must be paused and with `false` when it
+  // may be resumed.
+  using PauseHandler = std::function<void(bool pause)>;
+
+  UdpReceiveQueue(const executor& executor,
+                  const UdpTransportOptions& options,
+                  std::shared_ptr<UdpTransportCounters> counters,
+                  PauseHandler pause_handler);
+  ~UdpReceiveQueue();
+
+  void Push(UdpSocket::Datagram&& datagram,
+            std::optional<ReceiveTimestamp> timestamp);
+
+  // Fails the next `Pop` with the error, ahead of queued datagrams. The queue
+  // remains open.
+  void PushError(error_code error);
+
+  // Queued datagrams remain readable, after that `Pop` fails with the error.
+  void Close(error_code error);
+
+  [[nodiscard]] awaitable<expected<ReceivedDatagram>> Pop();
+
+ private:
+  bool HasRoomFor(size_t datagram_size) const;
+  bool IsFull() const;
+  bool IsBelowHalf() const;
+
+  void SetPaused(bool paused);
+
+  const size_t max_datagrams_;
+  const size_t max_bytes_;
+  const UdpOverflowPolicy overflow_policy_;
+  const std::shared_ptr<UdpTransportCounters> counters_;
+  const PauseHandler pause_handler_;
+
+  std::deque<ReceivedDatagram> datagrams_;
+  size_t bytes_ = 0;
+  bool paused_ = false;
+
+  error_code pending_error_;
+
+  bool closed_ = false;
+  error_code close_error_;
+
+  boost::asio::experimental::channel<void(boost::system::error_code)>
+      notify_channel_;
+};
+
+UdpReceiveQueue::UdpReceiveQueue(const executor& executor,
+                                 const UdpTransportOptions& options,
+                                 std::shared_ptr<UdpTransportCounters> counters,
+                                 PauseHandler pause_handler)
+    : max_datagrams_{options.max_queued_datagrams},
+      max_bytes_{options.max_queued_bytes},
+      overflow_policy_{options.overflow_policy},
+      counters_{std::move(counters)},
+      pause_handler_{std::move(pause_handler)},
+      notify_channel_{executor, /*max_buffer_size=*/1} {}
+
+UdpReceiveQueue::~UdpReceiveQueue() {
+  SetPaused(false);
+}
+
+bool UdpReceiveQueue::HasRoomFor(size_t datagram_size) const {
+  return (max_datagrams_ == 0 || datagrams_.size() < max_datagrams_) &&
+         (max_bytes_ == 0 || bytes_ + datagram_size <= max_bytes_);
+}
+
+bool UdpReceiveQueue::IsFull() const {
+  return (max_datagrams_ != 0 && datagrams_.size() >= max_datagrams_) ||
+         (max_bytes_ != 0 && bytes_ >= max_bytes_);
+}
+
+bool UdpReceiveQueue::IsBelowHalf() const {
+  return (max_datagrams_ == 0 || datagrams_.size() <= max_datagrams_ / 2) &&
+         (max_bytes_ == 0 || bytes_ <= max_bytes_ / 2);
+}
+
+void UdpReceiveQueue::Push(UdpSocket::Datagram&& datagram,
+                           std::optional<ReceiveTimestamp> timestamp) {
+  if (closed_) {
+    return;
+  }
+
+  const size_t size = datagram.size();
+
+  if (!HasRoomFor(size)) {
+    const bool fits_empty_queue = max_bytes_ == 0 || size <= max_bytes_;
+    if (overflow_policy_ != UdpOverflowPolicy::DROP_OLDEST ||
+        !fits_empty_queue) {
+      ++counters_->dropped_datagrams;
+      counters_->dropped_bytes += size;
+      return;
+    }
+
+    while (!HasRoomFor(size)) {
+      ++counters_->dropped_datagrams;
+      counters_->dropped_bytes += datagrams_.front().data.size();
+      bytes_ -= datagrams_.front().data.size();
+      datagrams_.pop_front();
+    }
+  }
+
+  datagrams_.push_back({std::move(datagram), timestamp});
+  bytes_ += size;
+
+  // A notification may already be pending.
+  notify_channel_.try_send(boost::system::error_code{});
+
+  if (overflow_policy_ == UdpOverflowPolicy::PAUSE_READING && IsFull()) {
+    SetPaused(true);
+  }
+}
+
+void UdpReceiveQueue::PushError(error_code error) {
+  if (closed_) {
+    return;
+  }
+
+  pending_error_ = error;
+  notify_channel_.try_send(boost::system::error_code{});
+}
+
+void UdpReceiveQueue::Close(error_code error) {
+  if (closed_) {
+    return;
+  }
+
+  closed_ = true;
+  close_error_ = error ? error : ERR_CONNECTION_CLOSED;
+  SetPaused(false);
+  notify_channel_.try_send(boost::system::error_code{});
+}
+
+awaitable<expected<ReceivedDatagram>> UdpReceiveQueue::Pop() {
+  while (datagrams_.empty() && !pending_error_) {
+    if (closed_) {
+      co_return close_error_;
+    }
+
+    auto [error] = co_await notify_channel_.async_receive(
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+    if (error) {
+      co_return error;
+    }
+  }
+
+  if (pending_error_) {
+    co_return std::exchange(pending_error_, error_code{});
+  }
+
+  auto datagram = std::move(datagrams_.front());
+  datagrams_.pop_front();
+  bytes_ -= datagram.data.size();
+
+  if (paused_ && IsBelowHalf()) {
+    SetPaused(false);
+  }
+
+  co_return datagram;
+}
+
+void UdpReceiveQueue::SetPaused(bool paused) {
+  if (paused_ == paused) {
+    return;
+  }
+
+  paused_ = paused;
+
+  if (paused) {
+    ++counters_->read_pauses;
+  }
+
+  pause_handler_(paused);
+}
+
+}  // namespace
+
 // AcceptedUdpTransport
 
 class AcceptedUdpTransport final : public Transport {
@@ -30,6 +243,8 @@ class AcceptedUdpTransport final : public Transport {
   [[nodiscard]] virtual std::string name() const override;
   [[nodiscard]] virtual bool active() const override { return false; }
   [[nodiscard]] virtual bool connected() const override;
+  [[nodiscard]] virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const override;
   [[nodiscard]] virtual bool message_oriented() const override { return true; }
   [[nodiscard]] virtual executor get_executor() override;
 
@@ -78,7 +293,14 @@ class ActiveUdpTransport::UdpActiveCore final
   UdpActiveCore(const executor& executor,
                 UdpSocketFactory udp_socket_factory,
                 std::string host,
-                std::string service);
+                std::string service,
+                const UdpTransportOptions& options);
+
+  UdpTransportStats stats() const { return counters_->GetStats(); }
+
+  std::optional<ReceiveTimestamp> last_receive_timestamp() const {
+    return last_receive_timestamp_;
+  }
 
   // UdpTransportCore
   virtual executor get_executor() override { return executor_; }
@@ -98,34 +320,49 @@ class ActiveUdpTransport::UdpActiveCore final
 
   void OnSocketOpened(const UdpSocket::Endpoint& endpoint);
   void OnSocketMessage(const UdpSocket::Endpoint& endpoint,
-                       UdpSocket::Datagram&& datagram);
+                       UdpSocket::Datagram&& datagram,
+                       std::optional<ReceiveTimestamp> timestamp);
+  void OnSocketReadError(const UdpSocket::error_code& error);
   void OnSocketClosed(const UdpSocket::error_code& error);
 
   const executor executor_;
   const UdpSocketFactory udp_socket_factory_;
   const std::string host_;
   const std::string service_;
+  const UdpMulticastOptions multicast_;
 
   std::shared_ptr<UdpSocket> socket_;
 
   bool connected_ = false;
   UdpSocket::Endpoint peer_endpoint_;
 
-  boost::asio::experimental::channel<void(boost::system::error_code,
-                                          UdpSocket::Datagram datagram)>
-      read_channel_{executor_,
-                    /*max_buffer_size=*/std::numeric_limits<size_t>::max()};
+  std::optional<ReceiveTimestamp> last_receive_timestamp_;
+
+  const std::shared_ptr<UdpTransportCounters> counters_ =
+      std::make_shared<UdpTransportCounters>();
+
+  UdpReceiveQueue receive_queue_;
 };
 
 ActiveUdpTransport::UdpActiveCore::UdpActiveCore(
     const executor& executor,
     UdpSocketFactory udp_socket_factory,
     std::string host,
-    std::string service)
+    std::string service,
+    const UdpTransportOptions& options)
     : executor_{executor},
       udp_socket_factory_{std::move(udp_socket_factory)},
       host_{std::move(host)},
-      service_{std::move(service)} {}
+      service_{std::move(service)},
+      multicast_{options.multicast},
+      receive_queue_{executor_, options, counters_, [this](bool pause) {
+                       if (!socket_)
+                         return;
+                       if (pause)
+                         socket_->PauseReading();
+                       else
+                         socket_->ResumeReading();
+                     }} {}
 
 void ActiveUdpTransport::UdpActiveCore::shutdown() {
   socket_->Shutdown();
@@ -161,19 +398,18 @@ awaitable<expected<size_t>> ActiveUdpTransport::UdpActiveCore::read(
     std::span<char> data) {
   auto ref = shared_from_this();
 
-  auto [ec, datagram] = co_await read_channel_.async_receive(
-      boost::asio::as_tuple(boost::asio::use_awaitable));
-
-  if (ec) {
-    co_return ec;
+  auto datagram = co_await receive_queue_.Pop();
+  if (!datagram.ok()) {
+    co_return datagram.error();
   }
 
-  if (datagram.size() > data.size()) {
+  if (datagram->data.size() > data.size()) {
     co_return ERR_INVALID_ARGUMENT;
   }
 
-  std::ranges::copy(datagram, data.begin());
-  co_return datagram.size();
+  std::ranges::copy(datagram->data, data.begin());
+  last_receive_timestamp_ = datagram->timestamp;
+  co_return datagram->data.size();
 }
 
 awaitable<expected<size_t>> ActiveUdpTransport::UdpActiveCore::write(
@@ -189,14 +425,20 @@ void ActiveUdpTransport::UdpActiveCore::OnSocketOpened(
 
 void ActiveUdpTransport::UdpActiveCore::OnSocketMessage(
     const UdpSocket::Endpoint& endpoint,
-    UdpSocket::Datagram&& datagram) {
-  // TODO: Handle fail.
-  read_channel_.try_send(boost::system::error_code{}, std::move(datagram));
+    UdpSocket::Datagram&& datagram,
+    std::optional<ReceiveTimestamp> timestamp) {
+  receive_queue_.Push(std::move(datagram), timestamp);
+}
+
+void ActiveUdpTransport::UdpActiveCore::OnSocketReadError(
+    const UdpSocket::error_code& error) {
+  receive_queue_.PushError(error);
 }
 
 void ActiveUdpTransport::UdpActiveCore::OnSocketClosed(
     const UdpSocket::error_code& error) {
   connected_ = false;
+  receive_queue_.Close(error);
 }
 
 UdpSocketContext ActiveUdpTransport::UdpActiveCore::MakeUdpSocketImplContext() {
@@ -209,15 +451,22 @@ UdpSocketContext ActiveUdpTransport::UdpActiveCore::MakeUdpSocketImplContext() {
         if (auto ref = weak_ptr.lock())
           ref->OnSocketOpened(endpoint);
       },
-      [weak_ptr = weak_from_this()](const UdpSocket::Endpoint& endpoint,
-                                    UdpSocket::Datagram&& datagram) {
+      [weak_ptr = weak_from_this()](
+          const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+          std::optional<ReceiveTimestamp> timestamp) {
         if (auto ref = weak_ptr.lock())
-          ref->OnSocketMessage(endpoint, std::move(datagram));
+          ref->OnSocketMessage(endpoint, std::move(datagram), timestamp);
       },
       [weak_ptr = weak_from_this()](const UdpSocket::error_code& error) {
         if (auto ref = weak_ptr.lock())
           ref->OnSocketClosed(error);
       },
+      [weak_ptr = weak_from_this()](const UdpSocket::error_code& error) {
+        if (auto ref = weak_ptr.lock())
+          ref->OnSocketReadError(error);
+      },
+      /*reuse_port=*/false,
+      multicast_,
   };
 }
 
@@ -245,9 +494,14 @@ class AcceptedUdpTransport::UdpAcceptedCore final
       std::span<const char> data) override;
   virtual void shutdown() override;
 
+  std::optional<ReceiveTimestamp> last_receive_timestamp() const {
+    return last_receive_timestamp_;
+  }
+
  private:
   void OnSocketMessage(const UdpSocket::Endpoint& endpoint,
-                       UdpSocket::Datagram&& datagram);
+                       UdpSocket::Datagram&& datagram,
+                       std::optional<ReceiveTimestamp> timestamp);
   void OnSocketClosed(const UdpSocket::error_code& error);
 
   executor executor_;
@@ -257,11 +511,9 @@ class AcceptedUdpTransport::UdpAcceptedCore final
 
   bool connected_ = true;
 
-  boost::asio::experimental::channel<void(boost::system::error_code,
-                                          std::vector<char> data)>
-      received_message_channel_{
-          executor_,
-          /*max_buffer_size=*/std::numeric_limits<size_t>::max()};
+  std::optional<ReceiveTimestamp> last_receive_timestamp_;
+
+  UdpReceiveQueue receive_queue_;
 
   friend class PassiveUdpTransport::UdpPassiveCore;
 };
@@ -276,7 +528,9 @@ class PassiveUdpTransport::UdpPassiveCore final
                  const log_source& log,
                  UdpSocketFactory udp_socket_factory,
                  std::string host,
-                 std::string service);
+                 std::string service,
+                 const UdpTransportOptions& options,
+                 std::shared_ptr<UdpPassiveCore> primary_shard);
   ~UdpPassiveCore();
 
   // UdpTransportCore
@@ -290,40 +544,86 @@ class PassiveUdpTransport::UdpPassiveCore final
       std::span<const char> data) override;
   virtual void shutdown() override;
 
+  UdpTransportStats stats() const { return counters_->GetStats(); }
+
  private:
   UdpSocketContext MakeUdpSocketImplContext();
 
   void OnSocketOpened(const UdpSocket::Endpoint& endpoint);
   void OnSocketMessage(const UdpSocket::Endpoint& endpoint,
-                       UdpSocket::Datagram&& datagram);
+                       UdpSocket::Datagram&& datagram,
+                       std::optional<ReceiveTimestamp> timestamp);
   void OnSocketClosed(const UdpSocket::error_code& error);
 
+  // Reading is paused while any accepted transport requests so.
+  void SetReadingPaused(bool paused);
+
   [[nodiscard]] awaitable<expected<size_t>> InternalWrite(
       UdpSocket::Endpoint endpoint,
       std::span<const char> datagram);
 
-  void RemoveAcceptedTransport(const UdpSocket::Endpoint& endpoint);
+  // Removes the transport unless it was already evicted and possibly replaced
+  // by a new transport from the same endpoint.
+  void RemoveAcceptedTransport(
+      const UdpSocket::Endpoint& endpoint,
+      const AcceptedUdpTransport::UdpAcceptedCore* accepted_core);
   void CloseAllAcceptedTransports(error_code error);
 
+  // Hands a transport accepted by an extra shard over to the primary shard.
+  void PostAcceptedTransport(
+      std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore> accepted_core);
+
+  void StartIdleTimer();
+  void OnIdleTimer();
+  void EvictAcceptedTransport(const UdpEndpointKey& key, error_code error);
+
+  struct AcceptedEntry {
+    std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore> core;
+    // Distinguishes entries from the same endpoint in `idle_wheel_`.
+    uint64_t id = 0;
+    // Updated per datagram. The wheel entry is rescheduled lazily.
+    uint64_t last_activity_tick = 0;
+  };
+
+  struct IdleWheelKey {
+    UdpEndpointKey endpoint_key;
+    uint64_t id = 0;
+  };
+
+  // The idle timeout is checked with this resolution.
+  static constexpr int kIdleTicksPerTimeout = 8;
+
   const executor executor_;
   const log_source log_;
   const UdpSocketFactory udp_socket_factory_;
   const std::string host_;
   const std::string service_;
+  const UdpTransportOptions options_;
+  // Null for the primary shard, which owns the accept queue.
+  const std::shared_ptr<UdpPassiveCore> primary_shard_;
 
   std::shared_ptr<UdpSocket> socket_;
 
   bool connected_ = false;
 
-  std::map<UdpSocket::Endpoint,
-           std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore>>
-      accepted_transports_;
+  UdpEndpointTable<AcceptedEntry> accepted_transports_;
+  uint64_t next_accepted_id_ = 0;
+
+  Timer idle_timer_{executor_};
+  TimerWheel<IdleWheelKey> idle_wheel_;
+  uint64_t idle_timeout_ticks_ = 0;
+
+  // Shared by all shards.
+  const std::shared_ptr<UdpTransportCounters> counters_;
+  int read_pause_count_ = 0;
 
   boost::asio::experimental::channel<void(
       boost::system::error_code,
       std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore>)>
       accept_channel_{executor_,
-                      /*max_buffer_size=*/std::numeric_limits<size_t>::max()};
+                      /*max_buffer_size=*/options_.max_pending_accepts != 0
+                          ? options_.max_pending_accepts
+                          : std::numeric_limits<size_t>::max()};
 
   friend class AcceptedUdpTransport::UdpAcceptedCore;
 };
@@ -335,12 +635,18 @@ PassiveUdpTransport::UdpPassiveCore::UdpPassiveCore(
     const log_source& log,
     UdpSocketFactory udp_socket_factory,
     std::string host,
-    std::string service)
+    std::string service,
+    const UdpTransportOptions& options,
+    std::shared_ptr<UdpPassiveCore> primary_shard)
     : executor_{executor},
       log_{log},
       udp_socket_factory_{std::move(udp_socket_factory)},
       host_{std::move(host)},
-      service_{std::move(service)} {}
+      service_{std::move(service)},
+      options_{options},
+      primary_shard_{std::move(primary_shard)},
+      counters_{primary_shard_ ? primary_shard_->counters_
+                               : std::make_shared<UdpTransportCounters>()} {}
 
 PassiveUdpTransport::UdpPassiveCore::~UdpPassiveCore() {
   assert(accepted_transports_.empty());
@@ -360,6 +666,10 @@ awaitable<error_code> PassiveUdpTransport::UdpPassiveCore::open() {
 }
 
 awaitable<error_code> PassiveUdpTransport::UdpPassiveCore::close() {
+  if (!socket_) {
+    co_return ERR_INVALID_HANDLE;
+  }
+
   auto ref = shared_from_this();
 
   co_await boost::asio::dispatch(executor_, boost::asio::use_awaitable);
@@ -367,6 +677,7 @@ awaitable<error_code> PassiveUdpTransport::UdpPassiveCore::close() {
   log_.write(LogSeverity::Normal, "Close");
 
   connected_ = false;
+  idle_timer_.Stop();
 
   co_await socket_->Close();
 
@@ -408,29 +719,47 @@ awaitable<expected<size_t>> PassiveUdpTransport::UdpPassiveCore::InternalWrite(
 }
 
 void PassiveUdpTransport::UdpPassiveCore::RemoveAcceptedTransport(
-    const UdpSocket::Endpoint& endpoint) {
-  boost::asio::dispatch(executor_, [this, endpoint, ref = shared_from_this()] {
+    const UdpSocket::Endpoint& endpoint,
+    const AcceptedUdpTransport::UdpAcceptedCore* accepted_core) {
+  boost::asio::dispatch(executor_, [this, endpoint, accepted_core,
+                                    ref = shared_from_this()] {
+    const auto key = MakeUdpEndpointKey(endpoint);
+    auto* entry = accepted_transports_.Find(key);
+    if (!entry || entry->core.get() != accepted_core) {
+      return;
+    }
+
     log_.write(
         LogSeverity::Normal,
         "Remove transport from endpoint {}. There are {} accepted transports",
         ToString(endpoint),
         accepted_transports_.size());
 
-    assert(accepted_transports_.contains(endpoint));
-
-    accepted_transports_.erase(endpoint);
+    accepted_transports_.Erase(key);
   });
 }
 
 void PassiveUdpTransport::UdpPassiveCore::OnSocketMessage(
     const UdpSocket::Endpoint& endpoint,
-    UdpSocket::Datagram&& datagram) {
+    UdpSocket::Datagram&& datagram,
+    std::optional<ReceiveTimestamp> timestamp) {
   std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore> accepted_core;
 
-  if (auto i = accepted_transports_.find(endpoint);
-      i != accepted_transports_.end()) {
-    accepted_core = i->second;
+  const auto key = MakeUdpEndpointKey(endpoint);
+  if (auto* entry = accepted_transports_.Find(key)) {
+    entry->last_activity_tick = idle_wheel_.now();
+    accepted_core = entry->core;
   } else {
+    if (options_.max_peers != 0 &&
+        accepted_transports_.size() >= options_.max_peers) {
+      ++counters_->dropped_peer_datagrams;
+      log_.write(LogSeverity::Warning,
+                 "Drop datagram from endpoint {}. Accepted transport limit "
+                 "{} is reached",
+                 ToString(endpoint), options_.max_peers);
+      return;
+    }
+
     log_.write(LogSeverity::Normal,
                 "Accept new transport from endpoint {}. There are {} accepted "
                 "transports",
@@ -440,21 +769,37 @@ void PassiveUdpTransport::UdpPassiveCore::OnSocketMessage(
     accepted_core = std::make_shared<AcceptedUdpTransport::UdpAcceptedCore>(
         executor_, log_, shared_from_this(), endpoint);
 
-    accepted_transports_.insert_or_assign(endpoint, accepted_core);
+    if (!primary_shard_ && !accept_channel_.try_send(
+                               boost::system::error_code{}, accepted_core)) {
+      ++counters_->dropped_peer_datagrams;
+      log_.write(LogSeverity::Warning,
+                 "Drop datagram from endpoint {}. Accept queue is full",
+                 ToString(endpoint));
+      return;
+    }
+
+    const uint64_t id = next_accepted_id_++;
+    accepted_transports_.Insert(
+        key, AcceptedEntry{.core = accepted_core,
+                           .id = id,
+                           .last_activity_tick = idle_wheel_.now()});
 
-    bool posted =
-        accept_channel_.try_send(boost::system::error_code{}, accepted_core);
+    if (idle_timeout_ticks_ != 0) {
+      idle_wheel_.Schedule(IdleWheelKey{key, id}, idle_timeout_ticks_);
+    }
 
-    if (!posted) {
-      log_.write(LogSeverity::Error, "Accept queue is full");
-      return;
+    // Posted once registered, so a rejected transport can be removed.
+    if (primary_shard_) {
+      PostAcceptedTransport(accepted_core);
     }
   }
 
   boost::asio::dispatch(
       accepted_core->get_executor(),
-      [accepted_core, endpoint, datagram = std::move(datagram)]() mutable {
-        accepted_core->OnSocketMessage(endpoint, std::move(datagram));
+      [accepted_core, endpoint, datagram = std::move(datagram),
+       timestamp]() mutable {
+        accepted_core->OnSocketMessage(endpoint, std::move(datagram),
+                                       timestamp);
       });
 }
 
@@ -466,15 +811,111 @@ void PassiveUdpTransport::UdpPassiveCore::CloseAllAcceptedTransports(
 
   std::vector<std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore>>
       accepted_cores;
-  for (const auto& [endpoint, accepted_core] : accepted_transports_) {
-    accepted_cores.push_back(accepted_core);
-  }
+  accepted_cores.reserve(accepted_transports_.size());
+  accepted_transports_.ForEach(
+      [&](const UdpEndpointKey& key, const AcceptedEntry& entry) {
+        accepted_cores.push_back(entry.core);
+      });
 
   for (const auto& accepted_core : accepted_cores) {
-    boost::asio::dispatch(accepted_core->get_executor(), [accepted_core] {
-      accepted_core->OnSocketClosed(UdpSocket::error_code{});
-    });
+    boost::asio::dispatch(accepted_core->get_executor(),
+                          [accepted_core, error] {
+                            accepted_core->OnSocketClosed(error);
+                          });
+  }
+}
+
+void PassiveUdpTransport::UdpPassiveCore::PostAcceptedTransport(
+    std::shared_ptr<AcceptedUdpTransport::UdpAcceptedCore> accepted_core) {
+  boost::asio::dispatch(
+      primary_shard_->executor_,
+      [primary_shard = primary_shard_, shard = shared_from_this(),
+       accepted_core = std::move(accepted_core)]() mutable {
+        if (primary_shard->accept_channel_.try_send(
+                boost::system::error_code{}, accepted_core)) {
+          return;
+        }
+
+        ++primary_shard->counters_->dropped_peer_datagrams;
+        primary_shard->log_.write(
+            LogSeverity::Warning,
+            "Drop transport from endpoint {}. Accept queue is full",
+            ToString(accepted_core->endpoint_));
+
+        shard->RemoveAcceptedTransport(accepted_core->endpoint_,
+                                       accepted_core.get());
+      });
+}
+
+void PassiveUdpTransport::UdpPassiveCore::SetReadingPaused(bool paused) {
+  if (paused) {
+    if (read_pause_count_++ == 0 && socket_) {
+      log_.write(LogSeverity::Warning, "Pause reading");
+      socket_->PauseReading();
+    }
+  } else {
+    assert(read_pause_count_ > 0);
+    if (--read_pause_count_ == 0 && socket_) {
+      log_.write(LogSeverity::Normal, "Resume reading");
+      socket_->ResumeReading();
+    }
+  }
+}
+
+void PassiveUdpTransport::UdpPassiveCore::StartIdleTimer() {
+  if (options_.idle_timeout.count() <= 0) {
+    return;
   }
+
+  const auto tick_period = std::max(
+      std::chrono::milliseconds{1},
+      options_.idle_timeout / kIdleTicksPerTimeout);
+  idle_timeout_ticks_ = static_cast<uint64_t>(
+      (options_.idle_timeout + tick_period - std::chrono::milliseconds{1}) /
+      tick_period);
+
+  idle_timer_.StartRepeating(tick_period, [weak_ptr = weak_from_this()] {
+    if (auto ref = weak_ptr.lock())
+      ref->OnIdleTimer();
+  });
+}
+
+void PassiveUdpTransport::UdpPassiveCore::OnIdleTimer() {
+  idle_wheel_.Advance([this](const IdleWheelKey& wheel_key) {
+    auto* entry = accepted_transports_.Find(wheel_key.endpoint_key);
+    if (!entry || entry->id != wheel_key.id) {
+      return;
+    }
+
+    const uint64_t idle_ticks = idle_wheel_.now() - entry->last_activity_tick;
+    if (idle_ticks < idle_timeout_ticks_) {
+      idle_wheel_.Schedule(wheel_key, idle_timeout_ticks_ - idle_ticks);
+      return;
+    }
+
+    EvictAcceptedTransport(wheel_key.endpoint_key, ERR_TIMED_OUT);
+  });
+}
+
+void PassiveUdpTransport::UdpPassiveCore::EvictAcceptedTransport(
+    const UdpEndpointKey& key,
+    error_code error) {
+  auto* entry = accepted_transports_.Find(key);
+  assert(entry);
+
+  auto accepted_core = std::move(entry->core);
+  accepted_transports_.Erase(key);
+
+  log_.write(LogSeverity::Normal,
+             "Evict transport from endpoint {} - {}. There are {} accepted "
+             "transports",
+             ToString(accepted_core->endpoint_), ErrorToString(error),
+             accepted_transports_.size());
+
+  boost::asio::dispatch(accepted_core->get_executor(),
+                        [accepted_core, error] {
+                          accepted_core->OnSocketClosed(error);
+                        });
 }
 
 void PassiveUdpTransport::UdpPassiveCore::OnSocketOpened(
@@ -483,6 +924,7 @@ void PassiveUdpTransport::UdpPassiveCore::OnSocketOpened(
               ToString(endpoint));
 
   connected_ = true;
+  StartIdleTimer();
 }
 
 void PassiveUdpTransport::UdpPassiveCore::OnSocketClosed(
@@ -490,6 +932,7 @@ void PassiveUdpTransport::UdpPassiveCore::OnSocketClosed(
   log_.write(LogSeverity::Normal, "Closed - {}", error.message());
 
   connected_ = false;
+  idle_timer_.Stop();
   CloseAllAcceptedTransports(error);
 }
 
@@ -504,15 +947,20 @@ PassiveUdpTransport::UdpPassiveCore::MakeUdpSocketImplContext() {
         if (auto ref = weak_ptr.lock())
           ref->OnSocketOpened(endpoint);
       },
-      [weak_ptr = weak_from_this()](const UdpSocket::Endpoint& endpoint,
-                                    UdpSocket::Datagram&& datagram) {
+      [weak_ptr = weak_from_this()](
+          const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+          std::optional<ReceiveTimestamp> timestamp) {
         if (auto ref = weak_ptr.lock())
-          ref->OnSocketMessage(endpoint, std::move(datagram));
+          ref->OnSocketMessage(endpoint, std::move(datagram), timestamp);
       },
       [weak_ptr = weak_from_this()](const UdpSocket::error_code& error) {
         if (auto ref = weak_ptr.lock())
           ref->OnSocketClosed(error);
       },
+      /*read_error_handler=*/{},
+      /*reuse_port=*/options_.shard_count > 1 &&
+          options_.multicast.group.empty(),
+      options_.multicast,
   };
 }
 
@@ -526,13 +974,21 @@ AcceptedUdpTransport::UdpAcceptedCore::UdpAcceptedCore(
     : executor_{executor},
       log_{log},
       passive_core_{std::move(passive_core)},
-      endpoint_{std::move(endpoint)} {
+      endpoint_{std::move(endpoint)},
+      receive_queue_{executor_, passive_core_->options_,
+                     passive_core_->counters_,
+                     [passive_core = passive_core_](bool pause) {
+                       boost::asio::dispatch(
+                           passive_core->executor_, [passive_core, pause] {
+                             passive_core->SetReadingPaused(pause);
+                           });
+                     }} {
   assert(passive_core_);
 }
 
 AcceptedUdpTransport::UdpAcceptedCore::~UdpAcceptedCore() {
   if (passive_core_) {
-    passive_core_->RemoveAcceptedTransport(endpoint_);
+    passive_core_->RemoveAcceptedTransport(endpoint_, this);
   }
 }
 
@@ -544,7 +1000,7 @@ awaitable<error_code> AcceptedUdpTransport::UdpAcceptedCore::open() {
 
 awaitable<error_code> AcceptedUdpTransport::UdpAcceptedCore::close() {
   if (passive_core_) {
-    passive_core_->RemoveAcceptedTransport(endpoint_);
+    passive_core_->RemoveAcceptedTransport(endpoint_, this);
     passive_core_ = nullptr;
   }
 
@@ -560,19 +1016,20 @@ AcceptedUdpTransport::UdpAcceptedCore::accept() {
 
 awaitable<expected<size_t>> AcceptedUdpTransport::UdpAcceptedCore::read(
     std::span<char> data) {
-  auto [ec, message] = co_await received_message_channel_.async_receive(
-      boost::asio::as_tuple(boost::asio::use_awaitable));
+  auto ref = shared_from_this();
 
-  if (ec) {
-    co_return ec;
+  auto message = co_await receive_queue_.Pop();
+  if (!message.ok()) {
+    co_return message.error();
   }
 
-  if (data.size() < message.size()) {
+  if (data.size() < message->data.size()) {
     co_return ERR_INVALID_ARGUMENT;
   }
 
-  std::ranges::copy(message, data.begin());
-  co_return message.size();
+  std::ranges::copy(message->data, data.begin());
+  last_receive_timestamp_ = message->timestamp;
+  co_return message->data.size();
 }
 
 awaitable<expected<size_t>> AcceptedUdpTransport::UdpAcceptedCore::write(
@@ -586,26 +1043,22 @@ awaitable<expected<size_t>> AcceptedUdpTransport::UdpAcceptedCore::write(
 
 void AcceptedUdpTransport::UdpAcceptedCore::OnSocketMessage(
     const UdpSocket::Endpoint& endpoint,
-    UdpSocket::Datagram&& datagram) {
-  bool posted = received_message_channel_.try_send(boost::system::error_code{},
-                                                   std::move(datagram));
-
-  if (!posted) {
-    log_.write(LogSeverity::Error, "Received message queue is full");
-    return;
-  }
+    UdpSocket::Datagram&& datagram,
+    std::optional<ReceiveTimestamp> timestamp) {
+  receive_queue_.Push(std::move(datagram), timestamp);
 }
 
 void AcceptedUdpTransport::UdpAcceptedCore::OnSocketClosed(
     const UdpSocket::error_code& error) {
-  assert(passive_core_);
-
   if (passive_core_) {
-    passive_core_->RemoveAcceptedTransport(endpoint_);
+    passive_core_->RemoveAcceptedTransport(endpoint_, this);
     passive_core_ = nullptr;
   }
 
   connected_ = false;
+
+  // Wakes up the reader once the queued datagrams are read.
+  receive_queue_.Close(error);
 }
 
 // ActiveUdpTransport
@@ -614,10 +1067,12 @@ ActiveUdpTransport::ActiveUdpTransport(const executor& executor,
                                        const log_source& log,
                                        UdpSocketFactory udp_socket_factory,
                                        std::string host,
-                                       std::string service) {
-  core_ =
-      std::make_shared<UdpActiveCore>(executor, std::move(udp_socket_factory),
-                                      std::move(host), std::move(service));
+                                       std::string service,
+                                       const UdpTransportOptions& options) {
+  core_ = std::make_shared<UdpActiveCore>(executor,
+                                          std::move(udp_socket_factory),
+                                          std::move(host), std::move(service),
+                                          options);
 }
 
 ActiveUdpTransport::~ActiveUdpTransport() {
@@ -625,6 +1080,10 @@ ActiveUdpTransport::~ActiveUdpTransport() {
                         [core = core_] { core->shutdown(); });
 }
 
+UdpTransportStats ActiveUdpTransport::stats() const {
+  return core_->stats();
+}
+
 executor ActiveUdpTransport::get_executor() {
   return core_->get_executor();
 }
@@ -633,6 +1092,11 @@ bool ActiveUdpTransport::connected() const {
   return core_->connected();
 }
 
+std::optional<ReceiveTimestamp> ActiveUdpTransport::last_receive_timestamp()
+    const {
+  return core_->last_receive_timestamp();
+}
+
 awaitable<error_code> ActiveUdpTransport::open() {
   return core_->open();
 }
@@ -664,16 +1128,37 @@ PassiveUdpTransport::PassiveUdpTransport(const executor& executor,
                                          const log_source& log,
                                          UdpSocketFactory udp_socket_factory,
                                          std::string host,
-                                         std::string service) {
-  core_ = std::make_shared<UdpPassiveCore>(executor, log,
-                                           std::move(udp_socket_factory),
-                                           std::move(host), std::move(service));
+                                         std::string service,
+                                         const UdpTransportOptions& options) {
+  core_ = std::make_shared<UdpPassiveCore>(executor, log, udp_socket_factory,
+                                           host, service, options,
+                                           /*primary_shard=*/nullptr);
+
+  const size_t shard_count =
+      options.multicast.group.empty() ? options.shard_count : 1;
+  for (size_t i = 1; i < shard_count; ++i) {
+    extra_shards_.emplace_back(std::make_shared<UdpPassiveCore>(
+        i <= options.shard_executors.size()
+            ? options.shard_executors[i - 1]
+            : boost::asio::make_strand(executor),
+        log, udp_socket_factory, host, service, options, core_));
+  }
 }
 
 PassiveUdpTransport::~PassiveUdpTransport() {
   boost::asio::co_spawn(
       core_->get_executor(), [core = core_] { return core->close(); },
       boost::asio::detached);
+
+  for (const auto& shard : extra_shards_) {
+    boost::asio::co_spawn(
+        shard->get_executor(), [shard] { return shard->close(); },
+        boost::asio::detached);
+  }
+}
+
+UdpTransportStats PassiveUdpTransport::stats() const {
+  return core_->stats();
 }
 
 executor PassiveUdpTransport::get_executor() {
@@ -685,11 +1170,46 @@ bool PassiveUdpTransport::connected() const {
 }
 
 awaitable<error_code> PassiveUdpTransport::open() {
-  return core_->open();
+  if (extra_shards_.empty()) {
+    return core_->open();
+  }
+
+  return OpenShards();
 }
 
 awaitable<error_code> PassiveUdpTransport::close() {
-  return core_->close();
+  if (extra_shards_.empty()) {
+    return core_->close();
+  }
+
+  return CloseShards();
+}
+
+awaitable<error_code> PassiveUdpTransport::OpenShards() {
+  NET_CO_RETURN_IF_ERROR(co_await core_->open());
+
+  // Each shard opens its socket on its own executor.
+  for (const auto& shard : extra_shards_) {
+    auto error = co_await boost::asio::co_spawn(
+        shard->get_executor(), [shard] { return shard->open(); },
+        boost::asio::use_awaitable);
+    if (error != OK) {
+      co_await CloseShards();
+      co_return error;
+    }
+  }
+
+  co_return OK;
+}
+
+awaitable<error_code> PassiveUdpTransport::CloseShards() {
+  for (const auto& shard : extra_shards_) {
+    co_await boost::asio::co_spawn(
+        shard->get_executor(), [shard] { return shard->close(); },
+        boost::asio::use_awaitable);
+  }
+
+  co_return co_await core_->close();
 }
 
 std::string PassiveUdpTransport::name() const {
@@ -728,6 +1248,11 @@ bool AcceptedUdpTransport::connected() const {
   return core_->connected();
 }
 
+std::optional<ReceiveTimestamp> AcceptedUdpTransport::last_receive_timestamp()
+    const {
+  return core_->last_receive_timestamp();
+}
+
 awaitable<error_code> AcceptedUdpTransport::open() {
   return core_->open();
 }
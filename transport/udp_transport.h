@@ -2,25 +2,103 @@
 
 #include "transport/log.h"
 #include "transport/transport.h"
+#include "transport/udp_socket.h"
 #include "transport/udp_socket_factory.h"
 
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
 namespace transport {
 
 class AcceptedUdpTransport;
 
+// What a transport does with a received datagram its receive queue has no room
+// for.
+enum class UdpOverflowPolicy {
+  // Drop the received datagram.
+  DROP_NEWEST,
+  // Drop the oldest queued datagrams to make room.
+  DROP_OLDEST,
+  // Stop reading from the socket until the queue drains to half of its limits
+  // and let the OS socket buffer shed the load. Pauses all peers of a passive
+  // transport.
+  PAUSE_READING,
+};
+
+struct UdpTransportOptions {
+  // Receive queue limits of an active transport and of each accepted
+  // transport. Zero means no limit.
+  size_t max_queued_datagrams = 1024;
+  size_t max_queued_bytes = 4 * 1024 * 1024;
+  UdpOverflowPolicy overflow_policy = UdpOverflowPolicy::DROP_NEWEST;
+
+  // Passive transport only. The limit of accepted transports not yet taken by
+  // `accept()`. Datagrams from further new peers are dropped. Zero means no
+  // limit.
+  size_t max_pending_accepts = 1024;
+
+  // Passive transport only. Accepted transports that receive no datagrams for
+  // this long are closed with `ERR_TIMED_OUT` and forgotten. Zero disables
+  // eviction.
+  std::chrono::milliseconds idle_timeout{0};
+
+  // Passive transport only. Once this many transports are accepted, datagrams
+  // from new peers are dropped. Zero means no limit.
+  size_t max_peers = 0;
+
+  // Passive transport only. The number of sockets bound to the same address
+  // with `SO_REUSEPORT`. Each shard reads on its own executor and keeps its own
+  // accepted transports, and the OS keeps a peer on the same shard. The limits
+  // above apply per shard. Requires an explicit port. Multicast receivers use a
+  // single socket, as each socket joined to a group receives a copy of every
+  // datagram.
+  size_t shard_count = 1;
+
+  // Passive transport only. Executors of the shards after the first one, which
+  // runs on the transport executor. A shard without an executor here runs on
+  // a strand of the transport executor, so shards only read in parallel if the
+  // transport executor runs on several threads and is not a strand itself.
+  std::vector<executor> shard_executors;
+
+  // An active transport whose host is a multicast group sends each message
+  // once to all group members. A passive transport receives the group
+  // datagrams when `multicast.group` is set, with an accepted transport per
+  // sender.
+  UdpMulticastOptions multicast;
+};
+
+// Overload counters. A passive transport reports the totals of its accepted
+// transports.
+struct UdpTransportStats {
+  // Received datagrams dropped because a receive queue was full.
+  uint64_t dropped_datagrams = 0;
+  uint64_t dropped_bytes = 0;
+  // Datagrams from new peers dropped because of `max_pending_accepts` or
+  // `max_peers`.
+  uint64_t dropped_peer_datagrams = 0;
+  // The number of times reading from the socket was paused.
+  uint64_t read_pauses = 0;
+};
+
 class ActiveUdpTransport final : public Transport {
  public:
   ActiveUdpTransport(const executor& executor,
                      const log_source& log,
                      UdpSocketFactory udp_socket_factory,
                      std::string host,
-                     std::string service);
+                     std::string service,
+                     const UdpTransportOptions& options = {});
 
   ~ActiveUdpTransport();
 
+  [[nodiscard]] UdpTransportStats stats() const;
+
   [[nodiscard]] virtual std::string name() const override;
   [[nodiscard]] virtual bool active() const override { return true; }
   [[nodiscard]] virtual bool connected() const override;
+  [[nodiscard]] virtual std::optional<ReceiveTimestamp> last_receive_timestamp()
+      const override;
   [[nodiscard]] virtual bool message_oriented() const override { return true; }
   [[nodiscard]] virtual executor get_executor() override;
 
@@ -46,10 +124,13 @@ class PassiveUdpTransport final : public Transport {
                       const log_source& log,
                       UdpSocketFactory udp_socket_factory,
                       std::string host,
-                      std::string service);
+                      std::string service,
+                      const UdpTransportOptions& options = {});
 
   ~PassiveUdpTransport();
 
+  [[nodiscard]] UdpTransportStats stats() const;
+
   [[nodiscard]] virtual std::string name() const override;
   [[nodiscard]] virtual bool active() const override { return false; }
   [[nodiscard]] virtual bool connected() const override;
@@ -69,7 +150,12 @@ class PassiveUdpTransport final : public Transport {
  private:
   class UdpPassiveCore;
 
+  [[nodiscard]] awaitable<error_code> OpenShards();
+  [[nodiscard]] awaitable<error_code> CloseShards();
+
+  // Accepts transports of all shards.
   std::shared_ptr<UdpPassiveCore> core_;
+  std::vector<std::shared_ptr<UdpPassiveCore>> extra_shards_;
 
   friend class AcceptedUdpTransport;
 };
@@ -4,10 +4,18 @@
 #include "transport/log.h"
 #include "transport/test/coroutine_util.h"
 #include "transport/udp_socket.h"
+#include "transport/udp_socket_impl.h"
 
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/system_executor.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/use_future.hpp>
 #include <gmock/gmock.h>
+#include <atomic>
+#include <mutex>
 #include <optional>
+#include <thread>
 
 namespace transport {
 
@@ -33,9 +41,20 @@ class MockUdpSocket : public UdpSocket {
               (Endpoint endpoint, std::span<const char> datagram),
               (override));
 
+  MOCK_METHOD(void, PauseReading, (), (override));
+  MOCK_METHOD(void, ResumeReading, (), (override));
+
   MOCK_METHOD(void, Shutdown, (), (override));
 };
 
+std::string GetFreeUdpPort() {
+  boost::asio::io_context io_context;
+  UdpSocket::Socket socket{
+      io_context,
+      UdpSocket::Endpoint{boost::asio::ip::make_address("127.0.0.1"), 0}};
+  return std::to_string(socket.local_endpoint().port());
+}
+
 }  // namespace
 
 class UdpTransportTest : public Test {
@@ -43,11 +62,16 @@ class UdpTransportTest : public Test {
   virtual void SetUp() override;
   virtual void TearDown() override;
 
-  [[nodiscard]] any_transport OpenTransport(bool active);
-  void ReceiveMessage();
+  [[nodiscard]] any_transport OpenTransport(
+      bool active,
+      const UdpTransportOptions& options = {});
+  void ReceiveMessage(
+      UdpSocket::Datagram datagram = {},
+      std::optional<ReceiveTimestamp> timestamp = std::nullopt);
 
   executor executor_ = boost::asio::system_executor{};
   std::shared_ptr<MockUdpSocket> socket = std::make_shared<MockUdpSocket>();
+  PassiveUdpTransport* passive_transport = nullptr;
   UdpSocketContext::OpenHandler open_handler;
   UdpSocketContext::MessageHandler message_handler;
 
@@ -62,15 +86,23 @@ void UdpTransportTest::SetUp() {}
 
 void UdpTransportTest::TearDown() {}
 
-any_transport UdpTransportTest::OpenTransport(bool active) {
-  auto transport = active ? any_transport{std::make_unique<ActiveUdpTransport>(
-                                executor_, log_source{}, udp_socket_factory,
-                                /*host=*/std::string{},
-                                /*service=*/std::string{})}
-                          : any_transport{std::make_unique<PassiveUdpTransport>(
-                                executor_, log_source{}, udp_socket_factory,
-                                /*host=*/std::string{},
-                                /*service=*/std::string{})};
+any_transport UdpTransportTest::OpenTransport(
+    bool active,
+    const UdpTransportOptions& options) {
+  any_transport transport;
+  if (active) {
+    transport = any_transport{std::make_unique<ActiveUdpTransport>(
+        executor_, log_source{}, udp_socket_factory,
+        /*host=*/std::string{},
+        /*service=*/std::string{}, options)};
+  } else {
+    auto passive = std::make_unique<PassiveUdpTransport>(
+        executor_, log_source{}, udp_socket_factory,
+        /*host=*/std::string{},
+        /*service=*/std::string{}, options);
+    passive_transport = passive.get();
+    transport = any_transport{std::move(passive)};
+  }
 
   EXPECT_CALL(*socket, Open());
 
@@ -88,10 +120,11 @@ any_transport UdpTransportTest::OpenTransport(bool active) {
   return transport;
 }
 
-void UdpTransportTest::ReceiveMessage() {
+void UdpTransportTest::ReceiveMessage(
+    UdpSocket::Datagram datagram,
+    std::optional<ReceiveTimestamp> timestamp) {
   const UdpSocket::Endpoint peer_endpoint;
-  UdpSocket::Datagram datagram;
-  message_handler(peer_endpoint, std::move(datagram));
+  message_handler(peer_endpoint, std::move(datagram), timestamp);
 }
 
 TEST_F(UdpTransportTest, UdpServer_AcceptedTransportImmediatelyDestroyed) {
@@ -123,6 +156,27 @@ TEST_F(UdpTransportTest, UdpServer_AcceptedTransportReceiveMessage) {
   EXPECT_CALL(*socket, Close());
 }
 
+TEST_F(UdpTransportTest, UdpServer_AcceptedTransportReportsReceiveTimestamp) {
+  auto transport = OpenTransport(/*active=*/false);
+  const auto timestamp = ReceiveTimestamp{std::chrono::seconds{1000}};
+  ReceiveMessage({'1'}, timestamp);
+  ReceiveMessage({'2'});
+
+  CoTest([&]() -> awaitable<void> {
+    auto accepted_transport = co_await transport.accept();
+    EXPECT_TRUE(accepted_transport.ok());
+    EXPECT_EQ(accepted_transport->last_receive_timestamp(), std::nullopt);
+
+    std::array<char, 16> buffer;
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+    EXPECT_EQ(accepted_transport->last_receive_timestamp(), timestamp);
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+    EXPECT_EQ(accepted_transport->last_receive_timestamp(), std::nullopt);
+  });
+
+  EXPECT_CALL(*socket, Close());
+}
+
 TEST_F(UdpTransportTest, UdpServer_AcceptedTransportClosed) {
   auto transport = OpenTransport(/*active=*/false);
   ReceiveMessage();
@@ -137,6 +191,483 @@ TEST_F(UdpTransportTest, UdpServer_AcceptedTransportClosed) {
   EXPECT_CALL(*socket, Close());
 }
 
+TEST_F(UdpTransportTest, UdpServer_FullReceiveQueueDropsNewest) {
+  auto transport = OpenTransport(
+      /*active=*/false,
+      {.max_queued_datagrams = 2,
+       .overflow_policy = UdpOverflowPolicy::DROP_NEWEST});
+  ReceiveMessage({'1'});
+  ReceiveMessage({'2'});
+  ReceiveMessage({'3', '3'});
+
+  CoTest([&]() -> awaitable<void> {
+    auto accepted_transport = co_await transport.accept();
+    EXPECT_TRUE(accepted_transport.ok());
+
+    std::array<char, 16> buffer;
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+    EXPECT_EQ(buffer[0], '1');
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+    EXPECT_EQ(buffer[0], '2');
+  });
+
+  const auto stats = passive_transport->stats();
+  EXPECT_EQ(stats.dropped_datagrams, 1u);
+  EXPECT_EQ(stats.dropped_bytes, 2u);
+
+  EXPECT_CALL(*socket, Close());
+}
+
+TEST_F(UdpTransportTest, UdpServer_FullReceiveQueueDropsOldest) {
+  auto transport = OpenTransport(
+      /*active=*/false,
+      {.max_queued_datagrams = 2,
+       .overflow_policy = UdpOverflowPolicy::DROP_OLDEST});
+  ReceiveMessage({'1'});
+  ReceiveMessage({'2'});
+  ReceiveMessage({'3'});
+
+  CoTest([&]() -> awaitable<void> {
+    auto accepted_transport = co_await transport.accept();
+    EXPECT_TRUE(accepted_transport.ok());
+
+    std::array<char, 16> buffer;
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+    EXPECT_EQ(buffer[0], '2');
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+    EXPECT_EQ(buffer[0], '3');
+  });
+
+  EXPECT_EQ(passive_transport->stats().dropped_datagrams, 1u);
+
+  EXPECT_CALL(*socket, Close());
+}
+
+TEST_F(UdpTransportTest, UdpServer_FullReceiveQueuePausesReading) {
+  auto transport = OpenTransport(
+      /*active=*/false,
+      {.max_queued_datagrams = 2,
+       .overflow_policy = UdpOverflowPolicy::PAUSE_READING});
+
+  EXPECT_CALL(*socket, PauseReading());
+  ReceiveMessage({'1'});
+  ReceiveMessage({'2'});
+  Mock::VerifyAndClearExpectations(socket.get());
+
+  CoTest([&]() -> awaitable<void> {
+    auto accepted_transport = co_await transport.accept();
+    EXPECT_TRUE(accepted_transport.ok());
+
+    EXPECT_CALL(*socket, ResumeReading());
+    std::array<char, 16> buffer;
+    EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+  });
+
+  EXPECT_CALL(*socket, Close());
+}
+
+// Runs a passive transport on a single-threaded context, so the idle timer
+// and the datagrams fed by the test never race.
+class PassiveUdpTransportLimitsTest : public Test {
+ public:
+  // Runs `func` on the transport executor until it completes.
+  template <class F>
+  void Run(const UdpTransportOptions& options, F&& func);
+
+  void ReceiveFrom(unsigned short port, UdpSocket::Datagram datagram = {'x'});
+
+  boost::asio::io_context io_context_;
+  std::shared_ptr<NiceMock<MockUdpSocket>> socket_ =
+      std::make_shared<NiceMock<MockUdpSocket>>();
+  UdpSocketContext::OpenHandler open_handler_;
+  UdpSocketContext::MessageHandler message_handler_;
+  std::unique_ptr<PassiveUdpTransport> transport_;
+};
+
+template <class F>
+void PassiveUdpTransportLimitsTest::Run(const UdpTransportOptions& options,
+                                        F&& func) {
+  ON_CALL(*socket_, Open()).WillByDefault(CoReturn(OK));
+
+  transport_ = std::make_unique<PassiveUdpTransport>(
+      io_context_.get_executor(), log_source{},
+      [&](UdpSocketContext&& context) {
+        open_handler_ = std::move(context.open_handler_);
+        message_handler_ = std::move(context.message_handler_);
+        return socket_;
+      },
+      /*host=*/std::string{}, /*service=*/std::string{}, options);
+
+  bool passed = false;
+  boost::asio::co_spawn(
+      io_context_,
+      [&]() -> awaitable<void> {
+        NET_EXPECT_OK(co_await transport_->open());
+        open_handler_(UdpSocket::Endpoint{});
+        co_await func();
+        NET_EXPECT_OK(co_await transport_->close());
+        passed = true;
+        io_context_.stop();
+      },
+      boost::asio::detached);
+
+  io_context_.run_for(std::chrono::seconds{5});
+
+  EXPECT_TRUE(passed);
+}
+
+void PassiveUdpTransportLimitsTest::ReceiveFrom(unsigned short port,
+                                                UdpSocket::Datagram datagram) {
+  const UdpSocket::Endpoint peer_endpoint{
+      boost::asio::ip::make_address("10.0.0.1"), port};
+  message_handler_(peer_endpoint, std::move(datagram),
+                   /*timestamp=*/std::nullopt);
+}
+
+TEST_F(PassiveUdpTransportLimitsTest, IdlePeerIsEvicted) {
+  Run({.idle_timeout = std::chrono::milliseconds{50}},
+      [&]() -> awaitable<void> {
+        ReceiveFrom(1000);
+
+        auto accepted_transport = co_await transport_->accept();
+        EXPECT_TRUE(accepted_transport.ok());
+
+        std::array<char, 16> buffer;
+        EXPECT_EQ(co_await accepted_transport->read(buffer), size_t{1});
+        EXPECT_EQ(co_await accepted_transport->read(buffer), ERR_TIMED_OUT);
+        EXPECT_FALSE(accepted_transport->connected());
+
+        // The evicted peer is forgotten, so its next datagram is accepted
+        // again.
+        ReceiveFrom(1000);
+        auto reaccepted_transport = co_await transport_->accept();
+        EXPECT_TRUE(reaccepted_transport.ok());
+      });
+}
+
+TEST_F(PassiveUdpTransportLimitsTest, PeerLimitDropsDatagramsOfNewPeers) {
+  Run({.max_peers = 1}, [&]() -> awaitable<void> {
+    ReceiveFrom(1000);
+    ReceiveFrom(2000);
+    EXPECT_EQ(transport_->stats().dropped_peer_datagrams, 1u);
+
+    auto accepted_transport = co_await transport_->accept();
+    EXPECT_TRUE(accepted_transport.ok());
+
+    // The known peer is not limited.
+    ReceiveFrom(1000);
+    EXPECT_EQ(transport_->stats().dropped_peer_datagrams, 1u);
+
+    // Closing the accepted transport frees its slot.
+    NET_EXPECT_OK(co_await accepted_transport->close());
+    ReceiveFrom(2000);
+    EXPECT_EQ(transport_->stats().dropped_peer_datagrams, 1u);
+    auto accepted_transport2 = co_await transport_->accept();
+    EXPECT_TRUE(accepted_transport2.ok());
+  });
+}
+
+TEST_F(PassiveUdpTransportLimitsTest, PendingAcceptLimitDropsNewPeers) {
+  Run({.max_pending_accepts = 1}, [&]() -> awaitable<void> {
+    ReceiveFrom(1000);
+    ReceiveFrom(2000);
+    EXPECT_EQ(transport_->stats().dropped_peer_datagrams, 1u);
+
+    auto accepted_transport = co_await transport_->accept();
+    EXPECT_TRUE(accepted_transport.ok());
+
+    // Accepting makes room for the dropped peer.
+    ReceiveFrom(2000);
+    EXPECT_EQ(transport_->stats().dropped_peer_datagrams, 1u);
+    auto accepted_transport2 = co_await transport_->accept();
+    EXPECT_TRUE(accepted_transport2.ok());
+  });
+}
+
+TEST(UdpTransportShardingTest, AcceptsPeersOfAllShards) {
+  std::vector<std::shared_ptr<NiceMock<MockUdpSocket>>> sockets;
+  std::vector<UdpSocketContext::MessageHandler> message_handlers;
+
+  UdpSocketFactory udp_socket_factory = [&](UdpSocketContext&& context) {
+    EXPECT_TRUE(context.reuse_port_);
+    message_handlers.emplace_back(std::move(context.message_handler_));
+    auto socket = std::make_shared<NiceMock<MockUdpSocket>>();
+    ON_CALL(*socket, Open()).WillByDefault(CoReturn(OK));
+    sockets.emplace_back(socket);
+    return socket;
+  };
+
+  any_transport transport{std::make_unique<PassiveUdpTransport>(
+      boost::asio::system_executor{}, log_source{}, udp_socket_factory,
+      /*host=*/std::string{}, /*service=*/std::string{"1234"},
+      UdpTransportOptions{.shard_count = 3})};
+
+  CoTest([&]() -> awaitable<void> {
+    NET_EXPECT_OK(co_await transport.open());
+    EXPECT_EQ(sockets.size(), 3u);
+
+    const UdpSocket::Endpoint peer_endpoint{
+        boost::asio::ip::make_address("10.0.0.1"), 1000};
+    message_handlers[2](peer_endpoint, {'1'}, /*timestamp=*/std::nullopt);
+
+    auto accepted_transport = co_await transport.accept();
+    EXPECT_TRUE(accepted_transport.ok());
+  });
+}
+
+// Shards on executors of their own read in parallel. Each shard handles a
+// datagram only once all shards are handling one.
+TEST(UdpTransportShardingTest, ShardsOnOwnExecutorsReadInParallel) {
+  constexpr size_t kShardCount = 3;
+
+  boost::asio::thread_pool thread_pool{kShardCount};
+
+  UdpTransportOptions options{.shard_count = kShardCount};
+  for (size_t i = 1; i < kShardCount; ++i) {
+    options.shard_executors.emplace_back(
+        boost::asio::make_strand(thread_pool.get_executor()));
+  }
+
+  struct Shard {
+    executor shard_executor;
+    UdpSocketContext::MessageHandler message_handler;
+  };
+
+  std::mutex mutex;
+  std::vector<Shard> shards;
+
+  UdpSocketFactory udp_socket_factory = [&](UdpSocketContext&& context) {
+    std::lock_guard lock{mutex};
+    shards.push_back({context.executor_, context.message_handler_});
+    auto socket = std::make_shared<NiceMock<MockUdpSocket>>();
+    ON_CALL(*socket, Open()).WillByDefault(CoReturn(OK));
+    return socket;
+  };
+
+  any_transport transport{std::make_unique<PassiveUdpTransport>(
+      boost::asio::make_strand(thread_pool.get_executor()), log_source{},
+      udp_socket_factory,
+      /*host=*/std::string{}, /*service=*/std::string{"1234"}, options)};
+
+  EXPECT_EQ(boost::asio::co_spawn(transport.get_executor(), transport.open(),
+                                  boost::asio::use_future)
+                .get(),
+            OK);
+  ASSERT_EQ(shards.size(), kShardCount);
+
+  std::atomic<size_t> reading_shards = 0;
+  std::atomic<size_t> parallel_shards = 0;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    boost::asio::post(shards[i].shard_executor, [&, i] {
+      ++reading_shards;
+      const auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds{5};
+      while (reading_shards < kShardCount &&
+             std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+      }
+      if (reading_shards == kShardCount) {
+        ++parallel_shards;
+      }
+
+      const UdpSocket::Endpoint peer_endpoint{
+          boost::asio::ip::make_address("10.0.0.1"),
+          static_cast<unsigned short>(1000 + i)};
+      shards[i].message_handler(peer_endpoint, {'x'},
+                                /*timestamp=*/std::nullopt);
+    });
+  }
+
+  auto accepted_count = boost::asio::co_spawn(
+      transport.get_executor(),
+      [&]() -> awaitable<size_t> {
+        size_t count = 0;
+        for (size_t i = 0; i < kShardCount; ++i) {
+          if ((co_await transport.accept()).ok()) {
+            ++count;
+          }
+        }
+        co_return count;
+      },
+      boost::asio::use_future);
+
+  EXPECT_EQ(accepted_count.get(), kShardCount);
+  EXPECT_EQ(parallel_shards, kShardCount);
+
+  EXPECT_EQ(boost::asio::co_spawn(transport.get_executor(), transport.close(),
+                                  boost::asio::use_future)
+                .get(),
+            OK);
+
+  thread_pool.join();
+}
+
+// A burst of equal-size datagrams is eligible for segmentation offload on the
+// sender and for coalescing on the receiver. Either way, the receiver must
+// observe the original datagrams in order.
+TEST(UdpSocketImplTest, BurstOfEqualSizeDatagramsIsDeliveredIndividually) {
+  constexpr size_t kDatagramCount = 32;
+  constexpr size_t kDatagramSize = 100;
+
+  boost::asio::io_context io_context;
+  const auto port = GetFreeUdpPort();
+
+  std::vector<UdpSocket::Datagram> received;
+  size_t timestamped = 0;
+  auto receiver = std::make_shared<UdpSocketImpl>(UdpSocketContext{
+      io_context.get_executor(), "127.0.0.1", port, /*active=*/false,
+      [](const UdpSocket::Endpoint& endpoint) {},
+      [&](const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+          std::optional<ReceiveTimestamp> timestamp) {
+        received.push_back(std::move(datagram));
+        if (timestamp) {
+          ++timestamped;
+        }
+        if (received.size() == kDatagramCount) {
+          io_context.stop();
+        }
+      },
+      [](const UdpSocket::error_code& error) {}});
+
+  UdpSocket::Endpoint peer_endpoint;
+  auto sender = std::make_shared<UdpSocketImpl>(UdpSocketContext{
+      io_context.get_executor(), "127.0.0.1", port, /*active=*/true,
+      [&](const UdpSocket::Endpoint& endpoint) { peer_endpoint = endpoint; },
+      [](const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+         std::optional<ReceiveTimestamp> timestamp) {},
+      [](const UdpSocket::error_code& error) {}});
+
+  std::vector<UdpSocket::Datagram> datagrams;
+  for (size_t i = 0; i < kDatagramCount; ++i) {
+    datagrams.emplace_back(kDatagramSize, static_cast<char>(i));
+  }
+
+  boost::asio::co_spawn(
+      io_context,
+      [&]() -> awaitable<void> {
+        NET_EXPECT_OK(co_await receiver->Open());
+        NET_EXPECT_OK(co_await sender->Open());
+        // The first datagram is sent right away. The rest are queued before
+        // the writer runs, so they form a single batch.
+        for (const auto& datagram : datagrams) {
+          auto result = co_await sender->SendTo(peer_endpoint, datagram);
+          EXPECT_EQ(result, kDatagramSize);
+        }
+      },
+      boost::asio::detached);
+
+  io_context.run_for(std::chrono::seconds{5});
+
+  EXPECT_EQ(received, datagrams);
+
+  // Kernels without segmentation offload get the datagrams sent one by one.
+  if (sender->gso_enabled()) {
+    EXPECT_EQ(sender->segmented_send_count(), 1u);
+  }
+
+  // Coalesced datagrams share the kernel receive timestamp.
+  if (receiver->timestamps_enabled()) {
+    EXPECT_EQ(timestamped, kDatagramCount);
+  }
+
+  sender->Shutdown();
+  receiver->Shutdown();
+}
+
+#if defined(__linux__)
+// The active socket is connected, so an ICMP port unreachable from the peer is
+// reported without closing the socket.
+TEST(UdpSocketImplTest, UnreachablePeerIsReportedAsReadError) {
+  boost::asio::io_context io_context;
+  const auto port = GetFreeUdpPort();
+
+  std::optional<UdpSocket::error_code> read_error;
+  bool closed = false;
+  auto socket = std::make_shared<UdpSocketImpl>(UdpSocketContext{
+      io_context.get_executor(), "127.0.0.1", port, /*active=*/true,
+      [](const UdpSocket::Endpoint& endpoint) {},
+      [](const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+         std::optional<ReceiveTimestamp> timestamp) {},
+      [&](const UdpSocket::error_code& error) { closed = true; },
+      [&](const UdpSocket::error_code& error) {
+        read_error = error;
+        io_context.stop();
+      }});
+
+  boost::asio::co_spawn(
+      io_context,
+      [&]() -> awaitable<void> {
+        NET_EXPECT_OK(co_await socket->Open());
+        const char datagram[] = "ping";
+        auto result = co_await socket->SendTo({}, datagram);
+        EXPECT_TRUE(result.ok());
+      },
+      boost::asio::detached);
+
+  io_context.run_for(std::chrono::seconds{5});
+
+  ASSERT_TRUE(read_error.has_value());
+  EXPECT_EQ(*read_error,
+            UdpSocket::error_code{boost::asio::error::connection_refused});
+  EXPECT_FALSE(closed);
+
+  socket->Shutdown();
+}
+
+// A group member bound to the wildcard address receives a datagram the sender
+// writes once to the group, looped back through the local interface.
+TEST(UdpSocketImplTest, MulticastDatagramReachesGroupMember) {
+  boost::asio::io_context io_context;
+  const auto port = GetFreeUdpPort();
+
+  const UdpMulticastOptions multicast{.group = "239.255.0.1",
+                                      .interface_address = "127.0.0.1",
+                                      .ttl = 1,
+                                      .loopback = true};
+
+  std::vector<UdpSocket::Datagram> received;
+  auto receiver = std::make_shared<UdpSocketImpl>(UdpSocketContext{
+      io_context.get_executor(), "0.0.0.0", port, /*active=*/false,
+      [](const UdpSocket::Endpoint& endpoint) {},
+      [&](const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+          std::optional<ReceiveTimestamp> timestamp) {
+        received.push_back(std::move(datagram));
+        io_context.stop();
+      },
+      [](const UdpSocket::error_code& error) {},
+      /*read_error_handler=*/{}, /*reuse_port=*/false, multicast});
+
+  auto sender_multicast = multicast;
+  sender_multicast.group.clear();
+  auto sender = std::make_shared<UdpSocketImpl>(UdpSocketContext{
+      io_context.get_executor(), "239.255.0.1", port, /*active=*/true,
+      [](const UdpSocket::Endpoint& endpoint) {},
+      [](const UdpSocket::Endpoint& endpoint, UdpSocket::Datagram&& datagram,
+         std::optional<ReceiveTimestamp> timestamp) {},
+      [](const UdpSocket::error_code& error) {},
+      /*read_error_handler=*/{}, /*reuse_port=*/false, sender_multicast});
+
+  const UdpSocket::Datagram datagram{'a', 'b', 'c'};
+
+  boost::asio::co_spawn(
+      io_context,
+      [&]() -> awaitable<void> {
+        NET_EXPECT_OK(co_await receiver->Open());
+        NET_EXPECT_OK(co_await sender->Open());
+        auto result = co_await sender->SendTo({}, datagram);
+        EXPECT_EQ(result, datagram.size());
+      },
+      boost::asio::detached);
+
+  io_context.run_for(std::chrono::seconds{5});
+
+  EXPECT_THAT(received, ElementsAre(datagram));
+
+  sender->Shutdown();
+  receiver->Shutdown();
+}
+#endif
+
 #if 0
 TEST_F(UdpTransportTest,
        UdpServer_AcceptedTransportDestroyedFromMessageHandler) {
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "transport/error.h"
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace transport {
+
+// A stream layer below `boost::beast::websocket::stream`. It counts the bytes
+// passing through, that is, the frames as they go to and from the TCP or TLS
+// stream, and optionally coalesces frames written in a row into a single write
+// to the next layer, so that small messages share a TLS record and a system
+// call.
+//
+// Once batching starts, writes complete as soon as their data is queued. The
+// queue is flushed `batch_delay` after the first write into it, or immediately
+// when `batch_bytes` are queued. Writes wait while a full queue is being
+// flushed. A failed flush fails all following writes.
+//
+// Complete frames shared by many connections, such as broadcast messages, can
+// be queued by reference with `async_write_shared`. Without batching they are
+// flushed immediately, between the frames the WebSocket stream writes.
+//
+// The stream is constructed in place by the WebSocket stream and must not be
+// moved.
+template <typename NextLayer>
+class WebSocketStreamLayer {
+ public:
+  using next_layer_type = NextLayer;
+  using executor_type = typename NextLayer::executor_type;
+
+  template <typename... Args>
+  WebSocketStreamLayer(size_t batch_bytes,
+                       std::chrono::microseconds batch_delay,
+                       Args&&... args)
+      : next_layer_{std::forward<Args>(args)...},
+        state_{std::make_shared<State>(next_layer_.get_executor(), batch_bytes,
+                                       batch_delay)} {}
+
+  WebSocketStreamLayer(const WebSocketStreamLayer&) = delete;
+  WebSocketStreamLayer& operator=(const WebSocketStreamLayer&) = delete;
+
+  executor_type get_executor() noexcept { return next_layer_.get_executor(); }
+
+  NextLayer& next_layer() { return next_layer_; }
+  const NextLayer& next_layer() const { return next_layer_; }
+
+  // Writes pass straight through until batching starts, so that the HTTP
+  // handshake is not delayed.
+  void start_batching() { batching_ = true; }
+
+  // Including the HTTP upgrade.
+  uint64_t bytes_read() const { return state_->bytes_read; }
+  uint64_t bytes_written() const { return state_->bytes_written; }
+
+  template <typename MutableBufferSequence, typename ReadToken>
+  auto async_read_some(const MutableBufferSequence& buffers,
+                       ReadToken&& token) {
+    return boost::asio::async_compose<ReadToken,
+                                      void(error_code, std::size_t)>(
+        ReadOp<MutableBufferSequence>{this, state_, buffers}, token,
+        next_layer_);
+  }
+
+  template <typename ConstBufferSequence, typename WriteToken>
+  auto async_write_some(const ConstBufferSequence& buffers,
+                        WriteToken&& token) {
+    if (!batching_) {
+      return boost::asio::async_compose<WriteToken,
+                                        void(error_code, std::size_t)>(
+          DirectWriteOp<ConstBufferSequence>{this, state_, buffers}, token,
+          next_layer_);
+    }
+
+    return boost::asio::async_compose<WriteToken,
+                                      void(error_code, std::size_t)>(
+        WriteOp<ConstBufferSequence>{this, state_, buffers}, token,
+        next_layer_);
+  }
+
+  // Queues a complete frame without copying it. `owner` keeps `data` alive
+  // until it is written. Completes once the frame is queued.
+  template <typename WriteToken>
+  auto async_write_shared(std::shared_ptr<const void> owner,
+                          boost::asio::const_buffer data,
+                          WriteToken&& token) {
+    return boost::asio::async_compose<WriteToken,
+                                      void(error_code, std::size_t)>(
+        SharedWriteOp{this, state_, std::move(owner), data}, token,
+        next_layer_);
+  }
+
+  // Completes once all queued data is written to the next layer.
+  template <typename FlushToken>
+  auto async_flush(FlushToken&& token) {
+    return boost::asio::async_compose<FlushToken, void(error_code)>(
+        FlushOp{this, state_}, token, next_layer_);
+  }
+
+ private:
+  struct State {
+    State(const executor_type& executor,
+          size_t batch_bytes,
+          std::chrono::microseconds batch_delay)
+        : batch_bytes{batch_bytes},
+          batch_delay{batch_delay},
+          delay_timer{executor},
+          flush_timer{executor, boost::asio::steady_timer::time_point::max()} {}
+
+    // A frame queued by reference. Goes before the bytes of `queue` from
+    // `offset` on.
+    struct SharedFrame {
+      size_t offset = 0;
+      std::shared_ptr<const void> owner;
+      boost::asio::const_buffer data;
+    };
+
+    size_t queued_bytes() const { return queue.size() + shared_bytes; }
+    bool queue_empty() const { return queue.empty() && shared_frames.empty(); }
+
+    const size_t batch_bytes;
+    const std::chrono::microseconds batch_delay;
+    std::vector<char> queue;
+    std::vector<SharedFrame> shared_frames;
+    size_t shared_bytes = 0;
+    std::vector<char> flushing_data;
+    std::vector<SharedFrame> flushing_shared_frames;
+    bool flushing = false;
+    // A write passing straight through to the next layer.
+    bool direct_writing = false;
+    bool flush_scheduled = false;
+    error_code error;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    boost::asio::steady_timer delay_timer;
+    // Never expires. Canceled to wake up operations waiting for a flush.
+    boost::asio::steady_timer flush_timer;
+  };
+
+  // Passes a read through to the next layer.
+  template <typename MutableBufferSequence>
+  struct ReadOp {
+    WebSocketStreamLayer* stream;
+    std::weak_ptr<State> weak_state;
+    MutableBufferSequence buffers;
+    bool started = false;
+
+    template <typename Self>
+    void operator()(Self& self,
+                    error_code ec = {},
+                    std::size_t bytes_transferred = 0) {
+      if (!started) {
+        started = true;
+        stream->next_layer_.async_read_some(buffers, std::move(self));
+        return;
+      }
+
+      if (auto state = weak_state.lock()) {
+        state->bytes_read += bytes_transferred;
+      }
+      self.complete(ec, bytes_transferred);
+    }
+  };
+
+  // Passes a write through to the next layer, after the queued shared frames.
+  // Writes all of the data, so that the frames queued meanwhile land between
+  // the frames of the WebSocket stream.
+  template <typename ConstBufferSequence>
+  struct DirectWriteOp {
+    WebSocketStreamLayer* stream;
+    std::weak_ptr<State> weak_state;
+    ConstBufferSequence buffers;
+    bool writing = false;
+
+    template <typename Self>
+    void operator()(Self& self,
+                    error_code ec = {},
+                    std::size_t bytes_written = 0) {
+      auto state = weak_state.lock();
+      if (!state) {
+        self.complete(boost::asio::error::operation_aborted, 0);
+        return;
+      }
+
+      if (writing) {
+        state->direct_writing = false;
+        state->bytes_written += bytes_written;
+        stream->StartFlush();
+        self.complete(ec, bytes_written);
+        return;
+      }
+
+      if (state->error) {
+        self.complete(state->error, 0);
+        return;
+      }
+
+      if (state->flushing || !state->queue_empty()) {
+        stream->StartFlush();
+        state->flush_timer.async_wait(std::move(self));
+        return;
+      }
+
+      writing = true;
+      state->direct_writing = true;
+      boost::asio::async_write(stream->next_layer_, buffers, std::move(self));
+    }
+  };
+
+  template <typename ConstBufferSequence>
+  struct WriteOp {
+    WebSocketStreamLayer* stream;
+    std::weak_ptr<State> weak_state;
+    ConstBufferSequence buffers;
+    bool completing = false;
+    error_code result = {};
+    std::size_t bytes_written = 0;
+
+    template <typename Self>
+    void operator()(Self& self, error_code = {}) {
+      auto state = weak_state.lock();
+      if (!state) {
+        self.complete(boost::asio::error::operation_aborted, 0);
+        return;
+      }
+
+      if (completing) {
+        self.complete(result, bytes_written);
+        return;
+      }
+
+      if (!state->error && state->queued_bytes() >= state->batch_bytes) {
+        state->flush_timer.async_wait(std::move(self));
+        return;
+      }
+
+      completing = true;
+      if (state->error) {
+        result = state->error;
+      } else {
+        bytes_written = boost::asio::buffer_size(buffers);
+        const auto offset = state->queue.size();
+        state->queue.resize(offset + bytes_written);
+        boost::asio::buffer_copy(
+            boost::asio::buffer(state->queue.data() + offset, bytes_written),
+            buffers);
+        state->bytes_written += bytes_written;
+      }
+
+      // Let the writer continue before the flush, so it can queue more.
+      auto* s = stream;
+      boost::asio::post(s->get_executor(), std::move(self));
+      s->ScheduleFlush();
+    }
+  };
+
+  struct SharedWriteOp {
+    WebSocketStreamLayer* stream;
+    std::weak_ptr<State> weak_state;
+    std::shared_ptr<const void> owner;
+    boost::asio::const_buffer data;
+    bool completing = false;
+    error_code result = {};
+
+    template <typename Self>
+    void operator()(Self& self, error_code = {}) {
+      auto state = weak_state.lock();
+      if (!state) {
+        self.complete(boost::asio::error::operation_aborted, 0);
+        return;
+      }
+
+      if (completing) {
+        self.complete(result, result ? 0 : data.size());
+        return;
+      }
+
+      if (!state->error && state->queued_bytes() >= state->batch_bytes) {
+        state->flush_timer.async_wait(std::move(self));
+        return;
+      }
+
+      completing = true;
+      if (state->error) {
+        result = state->error;
+      } else {
+        state->shared_frames.push_back(
+            {.offset = state->queue.size(), .owner = owner, .data = data});
+        state->shared_bytes += data.size();
+        state->bytes_written += data.size();
+      }
+
+      auto* s = stream;
+      boost::asio::post(s->get_executor(), std::move(self));
+      s->ScheduleFlush();
+    }
+  };
+
+  struct FlushOp {
+    WebSocketStreamLayer* stream;
+    std::weak_ptr<State> weak_state;
+    bool started = false;
+
+    template <typename Self>
+    void operator()(Self& self, error_code = {}) {
+      auto state = weak_state.lock();
+      if (!state) {
+        self.complete(boost::asio::error::operation_aborted);
+        return;
+      }
+
+      if (state->error || (state->queue_empty() && !state->flushing)) {
+        if (!started) {
+          // Don't complete from the initiating function.
+          started = true;
+          boost::asio::post(stream->get_executor(), std::move(self));
+          return;
+        }
+        self.complete(state->error);
+        return;
+      }
+
+      started = true;
+      stream->StartFlush();
+      state->flush_timer.async_wait(std::move(self));
+    }
+  };
+
+  void ScheduleFlush() {
+    auto& state = *state_;
+    if (state.flushing) {
+      // The flush completion picks up the queue.
+      return;
+    }
+
+    if (!batching_ || state.queued_bytes() >= state.batch_bytes) {
+      StartFlush();
+      return;
+    }
+
+    if (state.flush_scheduled) {
+      return;
+    }
+
+    state.flush_scheduled = true;
+    state.delay_timer.expires_after(state.batch_delay);
+    state.delay_timer.async_wait(
+        [this, weak_state = std::weak_ptr<State>{state_}](error_code ec) {
+          auto state = weak_state.lock();
+          if (ec || !state || !state->flush_scheduled) {
+            return;
+          }
+          state->flush_scheduled = false;
+          StartFlush();
+        });
+  }
+
+  void StartFlush() {
+    auto& state = *state_;
+    // A direct write flushes the queue once done.
+    if (state.flushing || state.direct_writing || state.error ||
+        state.queue_empty()) {
+      return;
+    }
+
+    state.flushing = true;
+    state.flush_scheduled = false;
+    std::swap(state.queue, state.flushing_data);
+    std::swap(state.shared_frames, state.flushing_shared_frames);
+    state.shared_bytes = 0;
+
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(state.flushing_shared_frames.size() * 2 + 1);
+    size_t offset = 0;
+    for (const auto& frame : state.flushing_shared_frames) {
+      if (frame.offset != offset) {
+        buffers.emplace_back(state.flushing_data.data() + offset,
+                             frame.offset - offset);
+        offset = frame.offset;
+      }
+      buffers.push_back(frame.data);
+    }
+    if (offset != state.flushing_data.size()) {
+      buffers.emplace_back(state.flushing_data.data() + offset,
+                           state.flushing_data.size() - offset);
+    }
+
+    boost::asio::async_write(
+        next_layer_, buffers,
+        [this, weak_state = std::weak_ptr<State>{state_}](error_code ec,
+                                                          std::size_t) {
+          auto state = weak_state.lock();
+          if (!state) {
+            return;
+          }
+          state->flushing = false;
+          state->flushing_data.clear();
+          state->flushing_shared_frames.clear();
+          if (ec) {
+            state->error = ec;
+          }
+          state->flush_timer.cancel();
+          // Schedule the data queued meanwhile.
+          if (!state->queue_empty()) {
+            ScheduleFlush();
+          }
+        });
+  }
+
+  NextLayer next_layer_;
+  const std::shared_ptr<State> state_;
+  bool batching_ = false;
+};
+
+// Flushes the queued frames, such as the closing frame, before tearing down
+// the next layer.
+template <typename NextLayer, typename TeardownHandler>
+void async_teardown(boost::beast::role_type role,
+                    WebSocketStreamLayer<NextLayer>& stream,
+                    TeardownHandler&& handler) {
+  auto executor =
+      boost::asio::get_associated_executor(handler, stream.get_executor());
+  stream.async_flush(boost::asio::bind_executor(
+      executor, [role, &stream, handler = std::forward<TeardownHandler>(
+                                    handler)](error_code ec) mutable {
+        if (ec) {
+          handler(ec);
+          return;
+        }
+        using boost::beast::websocket::async_teardown;
+        async_teardown(role, stream.next_layer(), std::move(handler));
+      }));
+}
+
+}  // namespace transport
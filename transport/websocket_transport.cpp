@@ -1,82 +1,180 @@
 #include "transport/websocket_transport.h"
 
-#include <boost/asio/buffer.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/connect.hpp>
-#include <boost/asio/detached.hpp>
-#include <boost/asio/ssl/context_base.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/beast/http/rfc7230.hpp>
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <exception>
+#include <format>
 #include <limits>
 #include <openssl/ssl.h>
 
 namespace transport {
 namespace {
 
+namespace http = boost::beast::http;
 namespace websocket = boost::beast::websocket;
 
-error_code ConfigureServerTlsContext(
-    boost::asio::ssl::context& context,
-    const WebSocketServerTlsConfig& config) {
-  boost::system::error_code ec;
+constexpr std::string_view kPrometheusContentType =
+    "text/plain; version=0.0.4; charset=utf-8";
+
+template <typename Value>
+void AppendPrometheusMetric(std::string& text,
+                            std::string_view name,
+                            std::string_view type,
+                            std::string_view help,
+                            Value value) {
+  text += std::format(
+      "# HELP transport_websocket_{0} {1}\n"
+      "# TYPE transport_websocket_{0} {2}\n"
+      "transport_websocket_{0} {3}\n",
+      name, help, type, value);
+}
 
-  context.set_options(boost::asio::ssl::context::default_workarounds |
-                          boost::asio::ssl::context::no_sslv2 |
-                          boost::asio::ssl::context::no_sslv3 |
-                          boost::asio::ssl::context::single_dh_use,
-                      ec);
-  if (ec)
-    return ec;
-
-  if (!config.private_key_passphrase.empty()) {
-    context.set_password_callback(
-        [password = config.private_key_passphrase](
-            std::size_t,
-            boost::asio::ssl::context_base::password_purpose) {
-          return password;
-        });
-  }
-
-  context.use_certificate_chain(
-      boost::asio::buffer(config.certificate_chain_pem), ec);
-  if (ec)
-    return ec;
-
-  context.use_private_key(boost::asio::buffer(config.private_key_pem),
-                          boost::asio::ssl::context::file_format::pem, ec);
-  if (ec)
-    return ec;
-
-  return OK;
+std::string FormatPrometheusMetrics(const WebSocketServerMetrics& metrics) {
+  std::string text;
+  AppendPrometheusMetric(text, "connections_open", "gauge",
+                         "Accepted connections not closed yet.",
+                         metrics.connections_open);
+  AppendPrometheusMetric(text, "accepts_pending", "gauge",
+                         "Upgraded connections waiting in the accept queue.",
+                         metrics.accepts_pending);
+  AppendPrometheusMetric(text, "accepts_dropped_total", "counter",
+                         "Upgraded connections dropped on a full queue.",
+                         metrics.accepts_dropped);
+  AppendPrometheusMetric(text, "handshakes_in_flight", "gauge",
+                         "Handshakes in progress.",
+                         metrics.handshakes_in_flight);
+  AppendPrometheusMetric(text, "handshakes_started_total", "counter",
+                         "Handshakes started.", metrics.handshakes_started);
+  AppendPrometheusMetric(text, "handshakes_completed_total", "counter",
+                         "Handshakes completed.",
+                         metrics.handshakes_completed);
+  AppendPrometheusMetric(text, "handshakes_failed_total", "counter",
+                         "Handshakes failed.", metrics.handshakes_failed);
+  AppendPrometheusMetric(text, "handshakes_timed_out_total", "counter",
+                         "Handshakes timed out.",
+                         metrics.handshakes_timed_out);
+  text += std::format(
+      "# HELP transport_websocket_handshake_duration_seconds Time from the "
+      "TCP accept to the upgrade.\n"
+      "# TYPE transport_websocket_handshake_duration_seconds summary\n"
+      "transport_websocket_handshake_duration_seconds_sum {}\n"
+      "transport_websocket_handshake_duration_seconds_count {}\n",
+      std::chrono::duration<double>{metrics.handshake_duration_sum}.count(),
+      metrics.handshakes_completed);
+  AppendPrometheusMetric(text, "messages_read_total", "counter",
+                         "Messages read by the accepted connections.",
+                         metrics.connections.messages_read);
+  AppendPrometheusMetric(text, "messages_written_total", "counter",
+                         "Messages written by the accepted connections.",
+                         metrics.connections.messages_written);
+  AppendPrometheusMetric(text, "message_bytes_read_total", "counter",
+                         "Message payload bytes read.",
+                         metrics.connections.message_bytes_read);
+  AppendPrometheusMetric(text, "message_bytes_written_total", "counter",
+                         "Message payload bytes written.",
+                         metrics.connections.message_bytes_written);
+  AppendPrometheusMetric(text, "http_requests_total", "counter",
+                         "Requests answered by the HTTP endpoints.",
+                         metrics.http_requests);
+  return text;
 }
 
-error_code ConfigureClientTlsContext(
-    boost::asio::ssl::context& context,
-    const WebSocketClientTlsConfig& config) {
-  boost::system::error_code ec;
+// A single unmasked frame holding the whole message (RFC 6455 5.2). RSV1 marks
+// a compressed message (RFC 7692 6).
+std::vector<char> MakeFrame(std::span<const char> payload,
+                            bool binary,
+                            bool compressed) {
+  std::vector<char> frame;
+  frame.reserve(payload.size() + 10);
+  frame.push_back(static_cast<char>(0x80 | (compressed ? 0x40 : 0) |
+                                    (binary ? 0x2 : 0x1)));
+  const uint64_t size = payload.size();
+  int length_bytes = 0;
+  if (size < 126) {
+    frame.push_back(static_cast<char>(size));
+  } else if (size <= 0xFFFF) {
+    frame.push_back(126);
+    length_bytes = 2;
+  } else {
+    frame.push_back(127);
+    length_bytes = 8;
+  }
+  for (int i = length_bytes - 1; i >= 0; --i)
+    frame.push_back(static_cast<char>(size >> (i * 8)));
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  return frame;
+}
 
-  context.set_options(boost::asio::ssl::context::default_workarounds |
-                          boost::asio::ssl::context::no_sslv2 |
-                          boost::asio::ssl::context::no_sslv3,
-                      ec);
-  if (ec)
-    return ec;
+// Compresses a message with a fresh context. Empty on failure.
+std::vector<char> DeflateMessage(std::span<const char> payload,
+                                 int window_bits,
+                                 const WebSocketDeflateOptions& options) {
+  namespace zlib = boost::beast::zlib;
+
+  zlib::deflate_stream stream;
+  stream.reset(options.compression_level, window_bits, options.memory_level,
+               zlib::Strategy::normal);
+
+  // Leaves room for the sync flush.
+  std::vector<char> output(stream.upper_bound(payload.size()) + 16);
+  zlib::z_params params;
+  params.next_in = payload.data();
+  params.avail_in = payload.size();
+  params.next_out = output.data();
+  params.avail_out = output.size();
+  error_code ec;
+  stream.write(params, zlib::Flush::sync, ec);
+  if (ec || params.avail_in != 0 || params.avail_out == 0)
+    return {};
+
+  // The sync flush ends with 00 00 FF FF, which is not sent (RFC 7692 7.2.1).
+  output.resize(params.total_out);
+  constexpr std::string_view kFlushTail{"\x00\x00\xFF\xFF", 4};
+  if (!std::string_view{output.data(), output.size()}.ends_with(kFlushTail))
+    return {};
+  output.resize(output.size() - kFlushTail.size());
+  return output;
+}
 
-  context.set_verify_mode(config.verify_peer ? boost::asio::ssl::verify_peer
-                                             : boost::asio::ssl::verify_none,
-                          ec);
-  if (ec)
-    return ec;
+}  // namespace
 
-  if (!config.ca_certificate_pem.empty()) {
-    context.add_certificate_authority(
-        boost::asio::buffer(config.ca_certificate_pem), ec);
-    if (ec)
-      return ec;
+WebSocketPreparedMessage::WebSocketPreparedMessage(
+    std::span<const char> payload,
+    bool binary,
+    const std::optional<WebSocketDeflateOptions>& deflate) {
+  auto frames = std::make_shared<Frames>();
+  frames->payload_size = payload.size();
+  frames->plain = MakeFrame(payload, binary, /*compressed=*/false);
+
+  if (deflate && !payload.empty() &&
+      payload.size() >= deflate->min_message_size) {
+    // Beast doesn't go below 9 bits either.
+    frames->deflate_window_bits =
+        std::clamp(deflate->server_max_window_bits, 9, 15);
+    auto compressed =
+        DeflateMessage(payload, frames->deflate_window_bits, *deflate);
+    if (!compressed.empty() && compressed.size() < payload.size()) {
+      frames->deflated = MakeFrame(compressed, binary, /*compressed=*/true);
+    }
   }
 
-  return OK;
+  frames_ = std::move(frames);
 }
 
-}  // namespace
+boost::asio::const_buffer WebSocketPreparedMessage::frame(
+    std::optional<int> deflate_window_bits) const {
+  // The peer's window must fit the back-references of the compressed message.
+  const auto& frame = !frames_->deflated.empty() && deflate_window_bits &&
+                              *deflate_window_bits >=
+                                  frames_->deflate_window_bits
+                          ? frames_->deflated
+                          : frames_->plain;
+  return boost::asio::buffer(frame);
+}
 
 WebSocketTransport::WebSocketTransport(const executor& executor,
                                        const log_source& log,
@@ -94,7 +192,10 @@ WebSocketTransport::WebSocketTransport(const executor& executor,
       mode_{active ? Mode::ACTIVE : Mode::PASSIVE},
       resolver_{executor},
       acceptor_{executor},
-      accept_channel_{executor, std::numeric_limits<size_t>::max()} {}
+      accept_channel_{executor, std::numeric_limits<size_t>::max()},
+      handshake_slot_timer_{executor,
+                            boost::asio::steady_timer::time_point::max()},
+      connection_totals_{std::make_shared<WebSocketConnectionTotals>()} {}
 
 awaitable<error_code> WebSocketTransport::open() {
   if (connected_) {
@@ -113,58 +214,43 @@ awaitable<error_code> WebSocketTransport::OpenActive() {
     co_return resolve_error;
   }
 
-  std::string handshake_host = host_ + ":" + service_;
-  if (client_options_.tls.has_value()) {
-    ssl_context_.emplace(boost::asio::ssl::context::tls_client);
-    const auto tls_error =
-        ConfigureClientTlsContext(*ssl_context_, *client_options_.tls);
-    if (tls_error != OK)
-      co_return tls_error;
-
-    websocket::stream<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>
-        websocket{executor_, *ssl_context_};
-    auto [connect_error, endpoint] = co_await boost::asio::async_connect(
-        websocket.next_layer().next_layer(), results,
-        boost::asio::as_tuple(boost::asio::use_awaitable));
-    if (connect_error)
-      co_return connect_error;
-
-    const auto& server_name = client_options_.tls->server_name.empty()
-                                  ? host_
-                                  : client_options_.tls->server_name;
-    if (!SSL_set_tlsext_host_name(websocket.next_layer().native_handle(),
-                                  server_name.c_str())) {
-      co_return ERR_FAILED;
-    }
-
-    auto [client_handshake_error] = co_await websocket.next_layer().async_handshake(
-        boost::asio::ssl::stream_base::client,
-        boost::asio::as_tuple(boost::asio::use_awaitable));
-    if (client_handshake_error)
-      co_return client_handshake_error;
-
-    handshake_host = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
-    co_return co_await OpenConnectedClient(std::move(websocket), handshake_host);
+  if (client_options_.tls_context && !tls_client_context_) {
+    tls_client_context_ = client_options_.tls_context;
+  } else if (client_options_.tls.has_value() && !tls_client_context_) {
+    NET_ASSIGN_OR_CO_RETURN(tls_client_context_,
+                            TlsClientContext::Create(*client_options_.tls));
   }
 
-  websocket::stream<boost::asio::ip::tcp::socket> websocket{executor_};
+  boost::asio::ip::tcp::socket socket{executor_};
   auto [connect_error, endpoint] = co_await boost::asio::async_connect(
-      websocket.next_layer(), results,
+      socket, results,
       boost::asio::as_tuple(boost::asio::use_awaitable));
   if (connect_error)
     co_return connect_error;
 
-  handshake_host = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
-  co_return co_await OpenConnectedClient(std::move(websocket), handshake_host);
+  const auto handshake_host =
+      endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+  if (!tls_client_context_)
+    co_return co_await OpenClientStream(std::move(socket), handshake_host);
+
+  auto& ssl_context = tls_client_context_->context();
+  if (client_options_.tls.has_value() && client_options_.tls->kernel_tls) {
+    co_return co_await OpenTlsClientStream(
+        KernelTlsStream{std::move(socket), ssl_context}, handshake_host);
+  }
+
+  co_return co_await OpenTlsClientStream(
+      boost::asio::ssl::stream<boost::asio::ip::tcp::socket>{std::move(socket),
+                                                             ssl_context},
+      handshake_host);
 }
 
 awaitable<error_code> WebSocketTransport::OpenPassive() {
-  if (server_options_.tls.has_value()) {
-    ssl_context_.emplace(boost::asio::ssl::context::tls_server);
-    const auto tls_error =
-        ConfigureServerTlsContext(*ssl_context_, *server_options_.tls);
-    if (tls_error != OK)
-      co_return tls_error;
+  if (server_options_.tls_context) {
+    ssl_context_ = server_options_.tls_context;
+  } else if (server_options_.tls.has_value() && !ssl_context_) {
+    NET_ASSIGN_OR_CO_RETURN(ssl_context_,
+                            CreateServerTlsContext(*server_options_.tls));
   }
 
   auto [resolve_error, results] = co_await resolver_.async_resolve(
@@ -210,47 +296,121 @@ awaitable<error_code> WebSocketTransport::OpenPassive() {
 
   connected_ = true;
   closed_ = false;
+  accept_loop_running_ = true;
   boost::asio::co_spawn(
-      executor_, [this]() { return AcceptLoop(); }, boost::asio::detached);
+      executor_, [this]() { return AcceptLoop(); },
+      [this](std::exception_ptr) {
+        accept_loop_running_ = false;
+        handshake_slot_timer_.cancel();
+      });
   co_return OK;
 }
 
 awaitable<void> WebSocketTransport::AcceptLoop() {
   while (!closed_) {
+    // Leave new connections in the listen backlog while handshakes are busy.
+    while (server_metrics_.handshakes_in_flight >=
+               server_options_.max_concurrent_handshakes &&
+           !closed_) {
+      co_await handshake_slot_timer_.async_wait(
+          boost::asio::as_tuple(boost::asio::use_awaitable));
+    }
+    if (closed_) {
+      co_return;
+    }
+
     auto [accept_error, socket] = co_await acceptor_.async_accept(
         boost::asio::as_tuple(boost::asio::use_awaitable));
     if (accept_error) {
       co_return;
     }
 
-    std::optional<any_transport> accepted;
-    if (ssl_context_.has_value()) {
-      boost::asio::ssl::stream<boost::asio::ip::tcp::socket> tls_stream{
-          std::move(socket), *ssl_context_};
-      auto [tls_error] = co_await tls_stream.async_handshake(
-          boost::asio::ssl::stream_base::server,
-          boost::asio::as_tuple(boost::asio::use_awaitable));
-      if (tls_error)
-        continue;
+    ++server_metrics_.handshakes_in_flight;
+    ++server_metrics_.handshakes_started;
+    auto cancellation = handshake_cancellations_.emplace(
+        handshake_cancellations_.end());
+    // The signal is only released once the handshake coroutine is gone.
+    boost::asio::co_spawn(
+        executor_,
+        [this, socket = std::move(socket)]() mutable {
+          return HandshakeConnection(std::move(socket));
+        },
+        boost::asio::bind_cancellation_slot(
+            cancellation->slot(), [this, cancellation](std::exception_ptr) {
+              handshake_cancellations_.erase(cancellation);
+              handshake_slot_timer_.cancel();
+            }));
+  }
+}
+
+awaitable<void> WebSocketTransport::HandshakeConnection(
+    boost::asio::ip::tcp::socket socket) {
+  // A canceled handshake fails with `operation_aborted` instead of throwing,
+  // so it still frees its slot.
+  co_await boost::asio::this_coro::throw_if_cancelled(false);
+
+  const auto start_time = std::chrono::steady_clock::now();
+  auto accepted = co_await AcceptConnection(std::move(socket));
+
+  --server_metrics_.handshakes_in_flight;
+  handshake_slot_timer_.cancel();
 
-      accepted = co_await AcceptUpgradedStream(
-          websocket::stream<
-              boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>{
-              std::move(tls_stream)});
+  if (!accepted.ok()) {
+    if (accepted.error() == boost::beast::error::timeout) {
+      ++server_metrics_.handshakes_timed_out;
     } else {
-      accepted = co_await AcceptUpgradedStream(
-          websocket::stream<boost::asio::ip::tcp::socket>{std::move(socket)});
+      ++server_metrics_.handshakes_failed;
     }
-    if (!accepted.has_value())
-      continue;
+    co_return;
+  }
 
-    accepted_.push(std::move(*accepted));
-    if (!accept_channel_.try_send(boost::system::error_code{})) {
-      log_.write(LogSeverity::Warning, "WebSocket accept queue is full");
-      accepted_.pop();
-      continue;
-    }
+  // Not a handshake failure.
+  if (!accepted->has_value()) {
+    co_return;
+  }
+
+  ++server_metrics_.handshakes_completed;
+  server_metrics_.handshake_duration_sum +=
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_time);
+
+  if (closed_) {
+    co_return;
   }
+
+  if (accepted_.size() >= server_options_.max_pending_accepts) {
+    log_.write(LogSeverity::Warning, "WebSocket accept queue is full");
+    ++server_metrics_.accepts_dropped;
+    co_return;
+  }
+
+  accepted_.push(std::move(**accepted));
+  if (!accept_channel_.try_send(boost::system::error_code{})) {
+    log_.write(LogSeverity::Warning, "WebSocket accept queue is full");
+    accepted_.pop();
+    ++server_metrics_.accepts_dropped;
+  }
+}
+
+awaitable<WebSocketTransport::UpgradeResult>
+WebSocketTransport::AcceptConnection(
+    boost::asio::ip::tcp::socket socket) {
+  if (ssl_context_ && server_options_.tls.has_value() &&
+      server_options_.tls->kernel_tls) {
+    co_return co_await AcceptTlsStream(
+        KernelTlsStream{std::move(socket), *ssl_context_});
+  }
+
+  boost::beast::tcp_stream stream{std::move(socket)};
+
+  if (!ssl_context_) {
+    stream.expires_after(server_options_.handshake_timeout);
+    co_return co_await AcceptStream(std::move(stream));
+  }
+
+  co_return co_await AcceptTlsStream(
+      boost::asio::ssl::stream<boost::beast::tcp_stream>{std::move(stream),
+                                                         *ssl_context_});
 }
 
 awaitable<error_code> WebSocketTransport::close() {
@@ -266,6 +426,14 @@ awaitable<error_code> WebSocketTransport::close() {
   acceptor_.cancel(ignored);
   acceptor_.close(ignored);
   accept_channel_.cancel();
+  handshake_slot_timer_.cancel();
+
+  for (auto& cancellation : handshake_cancellations_)
+    cancellation.emit(boost::asio::cancellation_type::terminal);
+  while (accept_loop_running_ || !handshake_cancellations_.empty()) {
+    co_await handshake_slot_timer_.async_wait(
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+  }
 
   if (core_) {
     co_return co_await core_->close();
@@ -305,6 +473,23 @@ awaitable<expected<size_t>> WebSocketTransport::read(std::span<char> data) {
   co_return result;
 }
 
+awaitable<expected<size_t>> WebSocketTransport::read_some(
+    std::span<char> data) {
+  if (mode_ == Mode::PASSIVE || !core_) {
+    co_return ERR_ACCESS_DENIED;
+  }
+
+  auto result = co_await core_->read_some(data);
+  if (result.ok() && *result == 0) {
+    connected_ = false;
+  }
+  co_return result;
+}
+
+bool WebSocketTransport::is_message_done() const {
+  return !core_ || core_->is_message_done();
+}
+
 awaitable<expected<size_t>> WebSocketTransport::write(std::span<const char> data) {
   if (mode_ == Mode::PASSIVE || !core_) {
     co_return ERR_ACCESS_DENIED;
@@ -313,6 +498,130 @@ awaitable<expected<size_t>> WebSocketTransport::write(std::span<const char> data
   co_return co_await core_->write(data);
 }
 
+awaitable<expected<size_t>> WebSocketTransport::write(
+    std::span<const char> data,
+    bool binary) {
+  if (mode_ == Mode::PASSIVE || !core_) {
+    co_return ERR_ACCESS_DENIED;
+  }
+
+  co_return co_await core_->write(data, binary);
+}
+
+awaitable<expected<size_t>> WebSocketTransport::write(
+    const WebSocketPreparedMessage& message) {
+  if (mode_ == Mode::PASSIVE || !core_) {
+    co_return ERR_ACCESS_DENIED;
+  }
+
+  co_return co_await core_->write(message);
+}
+
+WebSocketMetrics WebSocketTransport::metrics() const {
+  return core_ ? core_->metrics() : WebSocketMetrics{};
+}
+
+WebSocketServerMetrics WebSocketTransport::server_metrics() const {
+  auto metrics = server_metrics_;
+  metrics.accepts_pending = accepted_.size();
+  if (connection_totals_) {
+    const auto& totals = *connection_totals_;
+    metrics.connections_open =
+        totals.connections_open.load(std::memory_order_relaxed);
+    metrics.connections = {
+        .messages_read = totals.messages_read.load(std::memory_order_relaxed),
+        .messages_written =
+            totals.messages_written.load(std::memory_order_relaxed),
+        .message_bytes_read =
+            totals.message_bytes_read.load(std::memory_order_relaxed),
+        .message_bytes_written =
+            totals.message_bytes_written.load(std::memory_order_relaxed)};
+  }
+  return metrics;
+}
+
+std::optional<WebSocketTransport::HttpResponse>
+WebSocketTransport::ServeHttpEndpoint(
+    const WebSocketServerRequest& request) const {
+  if (request.method() != http::verb::get)
+    return std::nullopt;
+
+  std::string_view target{request.target().data(), request.target().size()};
+  target = target.substr(0, target.find('?'));
+
+  if (target == "/metrics") {
+    return HttpResponse{.status = http::status::ok,
+                        .content_type = std::string{kPrometheusContentType},
+                        .body = FormatPrometheusMetrics(server_metrics())};
+  }
+
+  if (target == "/healthz") {
+    if (closed_) {
+      return HttpResponse{.status = http::status::service_unavailable,
+                          .body = "closing\n"};
+    }
+    return HttpResponse{.status = http::status::ok, .body = "ok\n"};
+  }
+
+  return std::nullopt;
+}
+
+std::optional<std::chrono::microseconds> WebSocketTransport::smoothed_rtt()
+    const {
+  return core_ ? core_->smoothed_rtt() : std::nullopt;
+}
+
+std::optional<std::chrono::steady_clock::duration>
+WebSocketTransport::last_pong_age() const {
+  if (!connected_ || !core_)
+    return std::nullopt;
+  return core_->last_pong_age();
+}
+
+// static
+websocket::permessage_deflate WebSocketTransport::MakeDeflateOptions(
+    const WebSocketDeflateOptions& options) {
+  websocket::permessage_deflate result;
+  result.server_enable = true;
+  result.client_enable = true;
+  result.server_max_window_bits = options.server_max_window_bits;
+  result.client_max_window_bits = options.client_max_window_bits;
+  result.server_no_context_takeover = options.server_no_context_takeover;
+  result.client_no_context_takeover = options.client_no_context_takeover;
+  result.compLevel = options.compression_level;
+  result.memLevel = options.memory_level;
+  result.msg_size_threshold = options.min_message_size;
+  return result;
+}
+
+// static
+std::optional<int> WebSocketTransport::GetSharedDeflateWindowBits(
+    const websocket::response_type& response) {
+  const http::ext_list extensions{
+      response[http::field::sec_websocket_extensions]};
+  for (const auto& [name, params] : extensions) {
+    if (!boost::beast::iequals(name, "permessage-deflate"))
+      continue;
+
+    bool no_context_takeover = false;
+    // The default window is omitted.
+    int window_bits = 15;
+    for (const auto& [param, value] : params) {
+      if (boost::beast::iequals(param, "server_no_context_takeover")) {
+        no_context_takeover = true;
+      } else if (boost::beast::iequals(param, "server_max_window_bits")) {
+        const auto* value_end = value.data() + value.size();
+        auto [end, error] =
+            std::from_chars(value.data(), value_end, window_bits);
+        if (error != std::errc{} || end != value_end)
+          return std::nullopt;
+      }
+    }
+    return no_context_takeover ? std::optional{window_bits} : std::nullopt;
+  }
+  return std::nullopt;
+}
+
 boost::asio::ip::tcp::endpoint WebSocketTransport::local_endpoint() const {
   boost::system::error_code ec;
   return acceptor_.local_endpoint(ec);
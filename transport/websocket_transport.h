@@ -1,27 +1,41 @@
 #pragma once
 
 #include "transport/any_transport.h"
+#include "transport/kernel_tls_stream.h"
 #include "transport/log.h"
+#include "transport/tls_context.h"
 #include "transport/transport.h"
+#include "transport/websocket_stream_layer.h"
 
 #include <boost/asio/as_tuple.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/co_spawn.hpp>
 #include <boost/asio/experimental/channel.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core/stream_traits.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket/ssl.hpp>
 #include <boost/beast/websocket/stream.hpp>
 
-#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <list>
 #include <memory>
 #include <optional>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -33,25 +47,175 @@ using WebSocketClientResponse = boost::beast::websocket::response_type;
 using WebSocketServerRequest =
     boost::beast::http::request<boost::beast::http::string_body>;
 
-struct WebSocketServerTlsConfig {
-  std::string certificate_chain_pem;
-  std::string private_key_pem;
-  std::string private_key_passphrase;
+struct WebSocketWriteOptions {
+  // Splits outgoing messages into frames of `buffer_bytes`.
+  bool auto_fragment = true;
+  // The size of the buffer used to mask and compress outgoing frames.
+  size_t buffer_bytes = 4096;
+  // Packs frames of messages written in a row into a single write to the
+  // underlying stream. See `WebSocketStreamLayer`.
+  bool batching = false;
+  size_t batch_bytes = 16 * 1024;
+  std::chrono::microseconds batch_delay{200};
 };
 
-struct WebSocketClientTlsConfig {
-  bool verify_peer = false;
-  std::string server_name;
-  std::string ca_certificate_pem;
+// Tunes permessage-deflate, when enabled.
+struct WebSocketDeflateOptions {
+  // The LZ77 window sizes offered for each side, 9 to 15. Smaller windows take
+  // less memory per connection and compress worse.
+  int server_max_window_bits = 15;
+  int client_max_window_bits = 15;
+  // Resets the compression context after each message, so no window has to be
+  // kept between messages.
+  bool server_no_context_takeover = false;
+  bool client_no_context_takeover = false;
+  // The zlib compression level, 0 to 9, and memory level, 1 to 9.
+  int compression_level = 8;
+  int memory_level = 4;
+  // Smaller messages are sent uncompressed.
+  size_t min_message_size = 0;
+};
+
+// Pings the peer to keep the connection alive and to measure the round-trip
+// time. Like other inbound frames, pongs are processed only while a read is
+// pending.
+struct WebSocketKeepAliveOptions {
+  // Zero disables the pings.
+  std::chrono::milliseconds ping_interval{0};
+  // Fails the connection when no pong arrives for this long, so that reads
+  // and writes fail with `ERR_TIMED_OUT`. Zero disables the check.
+  std::chrono::milliseconds pong_timeout{0};
+};
+
+// Per-connection counters.
+struct WebSocketMetrics {
+  // Complete messages.
+  uint64_t messages_read = 0;
+  uint64_t messages_written = 0;
+  // Message payloads.
+  uint64_t message_bytes_read = 0;
+  uint64_t message_bytes_written = 0;
+  // Frames on the TCP or TLS stream, including the HTTP upgrade.
+  uint64_t wire_bytes_read = 0;
+  uint64_t wire_bytes_written = 0;
+
+  // Payload bytes per wire byte. Above one when compression pays off.
+  double read_compression_ratio() const {
+    return wire_bytes_read == 0 ? 1.0
+                                : static_cast<double>(message_bytes_read) /
+                                      static_cast<double>(wire_bytes_read);
+  }
+  double write_compression_ratio() const {
+    return wire_bytes_written == 0
+               ? 1.0
+               : static_cast<double>(message_bytes_written) /
+                     static_cast<double>(wire_bytes_written);
+  }
+};
+
+// Passive transport counters.
+struct WebSocketServerMetrics {
+  size_t handshakes_in_flight = 0;
+  uint64_t handshakes_started = 0;
+  uint64_t handshakes_completed = 0;
+  uint64_t handshakes_failed = 0;
+  uint64_t handshakes_timed_out = 0;
+  // Upgraded connections dropped because the accept queue is full.
+  uint64_t accepts_dropped = 0;
+  // Upgraded connections not taken by `accept` yet.
+  size_t accepts_pending = 0;
+  // From the TCP accept to the upgrade, over the completed handshakes.
+  std::chrono::microseconds handshake_duration_sum{0};
+  // Requests answered by the HTTP endpoints.
+  uint64_t http_requests = 0;
+  // Accepted connections not destroyed yet, and the message counters of all
+  // the accepted connections.
+  size_t connections_open = 0;
+  WebSocketMetrics connections;
+};
+
+// Counters shared by the connections accepted by a listener. The connections
+// may be used on other threads than the listener.
+struct WebSocketConnectionTotals {
+  std::atomic<size_t> connections_open = 0;
+  std::atomic<uint64_t> messages_read = 0;
+  std::atomic<uint64_t> messages_written = 0;
+  std::atomic<uint64_t> message_bytes_read = 0;
+  std::atomic<uint64_t> message_bytes_written = 0;
+};
+
+// The settings of a connected transport.
+struct WebSocketConnectionOptions {
+  // Sends binary frames instead of text ones by default.
+  bool binary = false;
+  WebSocketKeepAliveOptions keepalive;
+  // Shared by the connections accepted by a listener.
+  std::shared_ptr<WebSocketConnectionTotals> totals;
+  // Server frames are not masked, so prepared messages can be written.
+  bool server = false;
+  // The server LZ77 window of permessage-deflate, if the server compresses
+  // each message on its own, so that prepared compressed messages can be
+  // written.
+  std::optional<int> shared_deflate_window_bits;
+};
+
+// A message framed once, and optionally compressed once, to be written to
+// many accepted connections, such as a broadcast. Server frames are not masked,
+// so the same bytes suit every connection, and the connections share them
+// instead of copying. Copies are cheap.
+class WebSocketPreparedMessage {
+ public:
+  // With `deflate`, the message is also compressed on its own, for the
+  // connections that negotiated permessage-deflate without the server context
+  // takeover. The other connections get it uncompressed.
+  WebSocketPreparedMessage(
+      std::span<const char> payload,
+      bool binary,
+      const std::optional<WebSocketDeflateOptions>& deflate = std::nullopt);
+
+  [[nodiscard]] size_t payload_size() const { return frames_->payload_size; }
+  [[nodiscard]] bool compressed() const { return !frames_->deflated.empty(); }
+
+ private:
+  friend class WebSocketTransport;
+
+  struct Frames {
+    size_t payload_size = 0;
+    std::vector<char> plain;
+    // Empty if not compressed, or if compression doesn't pay off.
+    std::vector<char> deflated;
+    int deflate_window_bits = 15;
+  };
+
+  // The frame for a connection with the given shared deflate window. See
+  // `WebSocketConnectionOptions::shared_deflate_window_bits`.
+  [[nodiscard]] boost::asio::const_buffer frame(
+      std::optional<int> deflate_window_bits) const;
+
+  std::shared_ptr<const Frames> frames_;
 };
 
 struct WebSocketClientOptions {
   std::optional<WebSocketClientTlsConfig> tls;
+  // Shared by transports connecting to the same servers to resume TLS
+  // sessions across them. Takes precedence over `tls`. If not set, one is
+  // created from `tls` and kept for the reconnects of the transport.
+  std::shared_ptr<TlsClientContext> tls_context;
   std::string path = "/";
   std::function<void(WebSocketClientRequest&)> request_callback;
   std::function<std::optional<error_code>(const WebSocketClientResponse&)>
       response_validator;
   bool enable_permessage_deflate = false;
+  WebSocketDeflateOptions deflate;
+  // Sends binary frames instead of text ones by default. Binary payloads are
+  // not validated as UTF-8.
+  bool binary = false;
+  // Larger inbound messages fail the read and the connection.
+  size_t max_message_size = 16 * 1024 * 1024;
+  WebSocketWriteOptions write;
+  WebSocketKeepAliveOptions keepalive;
+  // See `WebSocketServerOptions::handshake_executor`.
+  std::optional<executor> handshake_executor;
 };
 
 struct WebSocketServerReject {
@@ -62,12 +226,38 @@ struct WebSocketServerReject {
 
 struct WebSocketServerOptions {
   std::optional<WebSocketServerTlsConfig> tls;
+  // Shared by listeners to parse the key once and accept each other's
+  // session tickets. Takes precedence over `tls`.
+  std::shared_ptr<boost::asio::ssl::context> tls_context;
   std::function<std::optional<WebSocketServerReject>(const WebSocketServerRequest&)>
       handshake_callback;
   bool enable_permessage_deflate = false;
+  WebSocketDeflateOptions deflate;
   std::vector<std::pair<std::string, std::string>> response_headers;
   std::function<void(boost::beast::websocket::response_type&)>
       response_callback;
+  // Accepted connections send binary frames instead of text ones by default.
+  bool binary = false;
+  // Connections past the limit wait in the listen backlog.
+  size_t max_concurrent_handshakes = 256;
+  // Covers the TLS handshake, the HTTP request and the upgrade.
+  std::chrono::milliseconds handshake_timeout{10000};
+  // Upgraded connections not taken by `accept` yet. New connections are
+  // dropped while the queue is full.
+  size_t max_pending_accepts = 1024;
+  // Larger inbound messages fail the read and the connection.
+  size_t max_message_size = 16 * 1024 * 1024;
+  WebSocketWriteOptions write;
+  // Applies to the accepted connections.
+  WebSocketKeepAliveOptions keepalive;
+  // Answers plain HTTP requests on the listener port: `GET /metrics` with
+  // `server_metrics` in the Prometheus text format, and `GET /healthz`.
+  bool serve_metrics = false;
+  // Runs the TLS handshakes, which are CPU-bound, on this executor, e.g. of a
+  // thread pool, so that reconnect storms don't stall the I/O of established
+  // connections. The sockets stay on the transport executor, where the
+  // connections continue once the handshake is done.
+  std::optional<executor> handshake_executor;
 };
 
 class WebSocketTransport final : public Transport {
@@ -80,14 +270,23 @@ class WebSocketTransport final : public Transport {
                      WebSocketServerOptions server_options = {},
                      WebSocketClientOptions client_options = {});
   template <typename WebSocketStream>
-  explicit WebSocketTransport(WebSocketStream websocket)
+  explicit WebSocketTransport(WebSocketStream websocket, bool binary = false)
+      : WebSocketTransport{std::move(websocket),
+                           WebSocketConnectionOptions{.binary = binary}} {}
+  template <typename WebSocketStream>
+  WebSocketTransport(WebSocketStream websocket,
+                     WebSocketConnectionOptions options)
       : executor_{websocket.get_executor()},
         resolver_{executor_},
         acceptor_{executor_},
         accept_channel_{executor_, std::numeric_limits<size_t>::max()},
+        handshake_slot_timer_{executor_,
+                              boost::asio::steady_timer::time_point::max()},
         mode_{Mode::CONNECTED},
         connected_{true},
-        core_{std::make_unique<CoreImpl<WebSocketStream>>(std::move(websocket))} {}
+        core_{std::make_unique<CoreImpl<WebSocketStream>>(std::move(websocket),
+                                                          std::move(options))} {
+  }
 
   [[nodiscard]] awaitable<error_code> open() override;
   [[nodiscard]] awaitable<error_code> close() override;
@@ -95,7 +294,31 @@ class WebSocketTransport final : public Transport {
   [[nodiscard]] awaitable<expected<size_t>> read(std::span<char> data) override;
   [[nodiscard]] awaitable<expected<size_t>> write(
       std::span<const char> data) override;
+  // Reads the next chunk of the current message, or the first chunk of the
+  // next message, so messages larger than `data` can be processed in parts.
+  // `is_message_done` tells whether the chunk completed the message. `read`
+  // must not be called in the middle of a message.
+  [[nodiscard]] awaitable<expected<size_t>> read_some(std::span<char> data);
+  [[nodiscard]] bool is_message_done() const;
+  // Sends a single message as a binary or text frame, regardless of the
+  // default frame type.
+  [[nodiscard]] awaitable<expected<size_t>> write(std::span<const char> data,
+                                                  bool binary);
+  // Writes a prepared message without copying it. Fails with
+  // `ERR_NOT_SUPPORTED` on the active transports, whose frames are masked.
+  // Like the other writes, must not run concurrently with them.
+  [[nodiscard]] awaitable<expected<size_t>> write(
+      const WebSocketPreparedMessage& message);
   [[nodiscard]] boost::asio::ip::tcp::endpoint local_endpoint() const;
+  [[nodiscard]] WebSocketMetrics metrics() const;
+  // The keepalive round-trip time, smoothed like TCP does. Empty until the
+  // first pong.
+  [[nodiscard]] std::optional<std::chrono::microseconds> smoothed_rtt() const;
+  // The time since the last pong, or since the connection if there was none.
+  // Empty if not connected.
+  [[nodiscard]] std::optional<std::chrono::steady_clock::duration>
+  last_pong_age() const;
+  [[nodiscard]] WebSocketServerMetrics server_metrics() const;
 
   [[nodiscard]] std::string name() const override;
   [[nodiscard]] bool message_oriented() const override { return true; }
@@ -116,43 +339,177 @@ class WebSocketTransport final : public Transport {
     [[nodiscard]] virtual awaitable<error_code> close() = 0;
     [[nodiscard]] virtual awaitable<expected<size_t>> read(
         std::span<char> data) = 0;
+    [[nodiscard]] virtual awaitable<expected<size_t>> read_some(
+        std::span<char> data) = 0;
+    [[nodiscard]] virtual bool is_message_done() const = 0;
+    [[nodiscard]] virtual WebSocketMetrics metrics() const = 0;
+    [[nodiscard]] virtual std::optional<std::chrono::microseconds>
+    smoothed_rtt() const = 0;
+    [[nodiscard]] virtual std::chrono::steady_clock::duration last_pong_age()
+        const = 0;
     [[nodiscard]] virtual awaitable<expected<size_t>> write(
         std::span<const char> data) = 0;
+    [[nodiscard]] virtual awaitable<expected<size_t>> write(
+        std::span<const char> data,
+        bool binary) = 0;
+    [[nodiscard]] virtual awaitable<expected<size_t>> write(
+        const WebSocketPreparedMessage& message) = 0;
   };
 
   template <typename WebSocketStream>
   class CoreImpl final : public Core {
    public:
-    explicit CoreImpl(WebSocketStream websocket)
-        : websocket_{std::move(websocket)} {}
+    CoreImpl(WebSocketStream websocket, WebSocketConnectionOptions options);
+    ~CoreImpl();
 
     [[nodiscard]] awaitable<error_code> close() override;
     [[nodiscard]] awaitable<expected<size_t>> read(
         std::span<char> data) override;
+    [[nodiscard]] awaitable<expected<size_t>> read_some(
+        std::span<char> data) override;
+    [[nodiscard]] bool is_message_done() const override {
+      return websocket_.is_message_done();
+    }
+    [[nodiscard]] WebSocketMetrics metrics() const override;
+    [[nodiscard]] std::optional<std::chrono::microseconds> smoothed_rtt()
+        const override {
+      return keepalive_->smoothed_rtt;
+    }
+    [[nodiscard]] std::chrono::steady_clock::duration last_pong_age()
+        const override {
+      return std::chrono::steady_clock::now() - keepalive_->last_pong_time;
+    }
     [[nodiscard]] awaitable<expected<size_t>> write(
         std::span<const char> data) override;
+    [[nodiscard]] awaitable<expected<size_t>> write(std::span<const char> data,
+                                                    bool binary) override;
+    [[nodiscard]] awaitable<expected<size_t>> write(
+        const WebSocketPreparedMessage& message) override;
 
    private:
+    // The chunk size used to skip messages not fitting the caller's buffer.
+    static constexpr size_t kDiscardChunkSize = 64 * 1024;
+
+    // Skips the rest of the current message, so that the next read starts at
+    // a message boundary.
+    [[nodiscard]] awaitable<error_code> DiscardMessage();
+
+    // Shared with the timer handlers, which can run after the core is gone.
+    struct KeepAlive {
+      KeepAlive(const executor& executor,
+                const WebSocketKeepAliveOptions& options)
+          : options{options},
+            timer{executor},
+            last_pong_time{std::chrono::steady_clock::now()} {}
+
+      const WebSocketKeepAliveOptions options;
+      boost::asio::steady_timer timer;
+      bool ping_in_flight = false;
+      // Set once the connection is failed for the missing pongs.
+      bool timed_out = false;
+      std::chrono::steady_clock::time_point last_pong_time;
+      std::optional<std::chrono::microseconds> smoothed_rtt;
+    };
+
+    void ScheduleKeepAlive();
+    void OnKeepAliveTimer();
+    void OnControlFrame(boost::beast::websocket::frame_type kind,
+                        std::string_view payload);
+
+    void CountBytesRead(size_t bytes);
+    void CountMessageRead();
+    void CountMessageWritten(size_t bytes);
+
+    // Reports the errors caused by the missing pongs as `ERR_TIMED_OUT`.
+    [[nodiscard]] error_code MapError(error_code ec) const {
+      return keepalive_->timed_out ? ERR_TIMED_OUT : ec;
+    }
+
     WebSocketStream websocket_;
+    const bool binary_;
+    const bool server_;
+    const std::optional<int> shared_deflate_window_bits_;
+    const std::shared_ptr<KeepAlive> keepalive_;
+    const std::shared_ptr<WebSocketConnectionTotals> totals_;
+
+    uint64_t messages_read_ = 0;
+    uint64_t messages_written_ = 0;
+    uint64_t message_bytes_read_ = 0;
+    uint64_t message_bytes_written_ = 0;
+
+    // Reused for discarded message data. Bounded by `kDiscardChunkSize`.
+    boost::beast::flat_buffer discard_buffer_;
   };
 
+  // The upgraded connection, or empty if an HTTP endpoint answered the
+  // request instead.
+  using UpgradeResult = expected<std::optional<any_transport>>;
+
   [[nodiscard]] awaitable<error_code> OpenActive();
   [[nodiscard]] awaitable<error_code> OpenPassive();
   [[nodiscard]] awaitable<void> AcceptLoop();
+  [[nodiscard]] awaitable<void> HandshakeConnection(
+      boost::asio::ip::tcp::socket socket);
+  [[nodiscard]] awaitable<UpgradeResult> AcceptConnection(
+      boost::asio::ip::tcp::socket socket);
   template <typename WebSocketStream>
   void ApplyClientOptions(WebSocketStream& websocket);
+  template <typename WebSocketStream>
+  static void ApplyWriteOptions(WebSocketStream& websocket,
+                                const WebSocketWriteOptions& options);
+  static boost::beast::websocket::permessage_deflate MakeDeflateOptions(
+      const WebSocketDeflateOptions& options);
+  // The server window of the negotiated permessage-deflate, if the server
+  // compresses each message on its own.
+  static std::optional<int> GetSharedDeflateWindowBits(
+      const boost::beast::websocket::response_type& response);
+  template <typename Stream>
+  [[nodiscard]] awaitable<error_code> OpenTlsClientStream(
+      Stream stream,
+      const std::string& handshake_host);
+  template <typename Stream>
+  [[nodiscard]] awaitable<error_code> OpenClientStream(
+      Stream stream,
+      const std::string& handshake_host);
   template <typename NextLayer>
   [[nodiscard]] awaitable<error_code> OpenConnectedClient(
       boost::beast::websocket::stream<NextLayer> websocket,
       const std::string& handshake_host);
+  struct HttpResponse {
+    boost::beast::http::status status = boost::beast::http::status::ok;
+    std::string content_type = "text/plain";
+    std::string body;
+  };
+
+  // Answers the requests to the endpoints enabled by
+  // `WebSocketServerOptions::serve_metrics`.
+  [[nodiscard]] std::optional<HttpResponse> ServeHttpEndpoint(
+      const WebSocketServerRequest& request) const;
+  // Writes a plain text response and shuts the connection down.
   template <typename Stream>
-  [[nodiscard]] awaitable<void> RejectRequest(
+  [[nodiscard]] awaitable<void> WriteHttpResponse(
       Stream& stream,
       boost::beast::http::status status,
       std::string body,
       const std::vector<std::pair<std::string, std::string>>& headers);
+  template <typename Stream>
+  [[nodiscard]] awaitable<UpgradeResult> AcceptTlsStream(
+      Stream stream);
+  template <typename Stream>
+  [[nodiscard]] awaitable<UpgradeResult> AcceptStream(Stream stream);
+  template <typename Stream>
+  [[nodiscard]] static awaitable<error_code> HandshakeTls(
+      Stream& stream,
+      boost::asio::ssl::stream_base::handshake_type type,
+      const std::optional<executor>& handshake_executor,
+      std::optional<std::chrono::steady_clock::time_point> deadline);
+  template <typename Stream>
+  [[nodiscard]] static awaitable<error_code> RunTlsHandshake(
+      Stream& stream,
+      boost::asio::ssl::stream_base::handshake_type type,
+      std::optional<std::chrono::steady_clock::time_point> deadline);
   template <typename NextLayer>
-  [[nodiscard]] awaitable<std::optional<any_transport>> AcceptUpgradedStream(
+  [[nodiscard]] awaitable<UpgradeResult> AcceptUpgradedStream(
       boost::beast::websocket::stream<NextLayer> websocket);
 
   executor executor_;
@@ -167,14 +524,127 @@ class WebSocketTransport final : public Transport {
 
   boost::asio::ip::tcp::resolver resolver_;
   boost::asio::ip::tcp::acceptor acceptor_;
-  std::optional<boost::asio::ssl::context> ssl_context_;
+  std::shared_ptr<boost::asio::ssl::context> ssl_context_;
+  std::shared_ptr<TlsClientContext> tls_client_context_;
   std::unique_ptr<Core> core_;
   std::queue<any_transport> accepted_;
   AcceptChannel accept_channel_;
+
+  // The accept loop and the handshakes refer to the transport, so `close` waits
+  // for them. A handshake is canceled with its signal.
+  bool accept_loop_running_ = false;
+  std::list<boost::asio::cancellation_signal> handshake_cancellations_;
+
+  // Never expires. Canceled when a handshake slot is freed, and when the accept
+  // loop or a handshake ends.
+  boost::asio::steady_timer handshake_slot_timer_;
+  WebSocketServerMetrics server_metrics_;
+  // Shared with the accepted connections. Null for the connected transports.
+  std::shared_ptr<WebSocketConnectionTotals> connection_totals_;
 };
 
+template <typename WebSocketStream>
+WebSocketTransport::CoreImpl<WebSocketStream>::CoreImpl(
+    WebSocketStream websocket,
+    WebSocketConnectionOptions options)
+    : websocket_{std::move(websocket)},
+      binary_{options.binary},
+      server_{options.server},
+      shared_deflate_window_bits_{options.shared_deflate_window_bits},
+      keepalive_{std::make_shared<KeepAlive>(websocket_.get_executor(),
+                                             options.keepalive)},
+      totals_{std::move(options.totals)} {
+  if (totals_)
+    totals_->connections_open.fetch_add(1, std::memory_order_relaxed);
+
+  // Beast replies to pings itself.
+  websocket_.control_callback(
+      [this](boost::beast::websocket::frame_type kind,
+             boost::beast::string_view payload) {
+        OnControlFrame(kind, std::string_view{payload.data(), payload.size()});
+      });
+  ScheduleKeepAlive();
+}
+
+template <typename WebSocketStream>
+WebSocketTransport::CoreImpl<WebSocketStream>::~CoreImpl() {
+  if (totals_)
+    totals_->connections_open.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <typename WebSocketStream>
+void WebSocketTransport::CoreImpl<WebSocketStream>::ScheduleKeepAlive() {
+  if (keepalive_->options.ping_interval.count() <= 0)
+    return;
+
+  keepalive_->timer.expires_after(keepalive_->options.ping_interval);
+  keepalive_->timer.async_wait(
+      [this, weak_keepalive = std::weak_ptr<KeepAlive>{keepalive_}](
+          error_code ec) {
+        if (ec || !weak_keepalive.lock())
+          return;
+        OnKeepAliveTimer();
+      });
+}
+
+template <typename WebSocketStream>
+void WebSocketTransport::CoreImpl<WebSocketStream>::OnKeepAliveTimer() {
+  const auto now = std::chrono::steady_clock::now();
+  const auto pong_timeout = keepalive_->options.pong_timeout;
+  if (pong_timeout.count() > 0 &&
+      now - keepalive_->last_pong_time >= pong_timeout) {
+    // Fails the pending reads and writes.
+    keepalive_->timed_out = true;
+    boost::beast::close_socket(boost::beast::get_lowest_layer(websocket_));
+    return;
+  }
+
+  // The payload is the send time, which the pong echoes.
+  if (!keepalive_->ping_in_flight) {
+    keepalive_->ping_in_flight = true;
+    websocket_.async_ping(
+        boost::beast::websocket::ping_data{
+            std::to_string(now.time_since_epoch().count())},
+        [weak_keepalive = std::weak_ptr<KeepAlive>{keepalive_}](error_code) {
+          if (auto keepalive = weak_keepalive.lock())
+            keepalive->ping_in_flight = false;
+        });
+  }
+
+  ScheduleKeepAlive();
+}
+
+template <typename WebSocketStream>
+void WebSocketTransport::CoreImpl<WebSocketStream>::OnControlFrame(
+    boost::beast::websocket::frame_type kind,
+    std::string_view payload) {
+  if (kind != boost::beast::websocket::frame_type::pong)
+    return;
+
+  const auto now = std::chrono::steady_clock::now();
+  keepalive_->last_pong_time = now;
+
+  // Pongs of other pings count as liveness only.
+  std::chrono::steady_clock::rep send_time = 0;
+  const auto* payload_end = payload.data() + payload.size();
+  auto [end, error] = std::from_chars(payload.data(), payload_end, send_time);
+  if (error != std::errc{} || end != payload_end)
+    return;
+
+  const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(
+      now.time_since_epoch() - std::chrono::steady_clock::duration{send_time});
+  if (rtt.count() < 0)
+    return;
+
+  // Smooths with the gain of 1/8, like TCP does (RFC 6298).
+  auto& smoothed_rtt = keepalive_->smoothed_rtt;
+  smoothed_rtt = smoothed_rtt ? *smoothed_rtt + (rtt - *smoothed_rtt) / 8 : rtt;
+}
+
 template <typename WebSocketStream>
 awaitable<error_code> WebSocketTransport::CoreImpl<WebSocketStream>::close() {
+  keepalive_->timer.cancel();
+
   auto [ec] = co_await websocket_.async_close(
       boost::beast::websocket::close_code::normal,
       boost::asio::as_tuple(boost::asio::use_awaitable));
@@ -182,50 +652,191 @@ awaitable<error_code> WebSocketTransport::CoreImpl<WebSocketStream>::close() {
     co_return OK;
   if (!ec)
     co_return OK;
-  co_return ec;
+  co_return MapError(ec);
 }
 
 template <typename WebSocketStream>
 awaitable<expected<size_t>> WebSocketTransport::CoreImpl<WebSocketStream>::read(
     std::span<char> data) {
-  boost::beast::flat_buffer buffer;
-  auto [ec, _] = co_await websocket_.async_read(
-      buffer, boost::asio::as_tuple(boost::asio::use_awaitable));
-  if (ec == boost::beast::websocket::error::closed)
-    co_return size_t{0};
-  if (ec)
-    co_return ec;
+  // Frames are read straight into the caller's buffer. Beast can't read text
+  // into an empty buffer, so a byte of scratch tells an empty message, which
+  // fits, from the others.
+  char scratch = 0;
+  const auto buffer = data.empty() ? std::span<char>{&scratch, 1} : data;
 
-  const auto size = buffer.size();
-  if (size > data.size())
-    co_return ERR_INVALID_ARGUMENT;
+  size_t size = 0;
+  for (;;) {
+    auto [ec, bytes_read] = co_await websocket_.async_read_some(
+        boost::asio::buffer(buffer.data() + size, buffer.size() - size),
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+    if (ec == boost::beast::websocket::error::closed)
+      co_return size_t{0};
+    if (ec)
+      co_return MapError(ec);
+
+    size += bytes_read;
+    CountBytesRead(bytes_read);
+
+    const bool message_done = websocket_.is_message_done();
+    if (message_done && size <= data.size())
+      break;
 
-  const auto buffer_data = buffer.data();
-  std::memcpy(data.data(), buffer_data.data(), size);
+    if (size >= data.size()) {
+      if (!message_done) {
+        auto discard_error = co_await DiscardMessage();
+        if (discard_error == boost::beast::websocket::error::closed)
+          co_return size_t{0};
+        if (discard_error)
+          co_return MapError(discard_error);
+      }
+      co_return ERR_INVALID_ARGUMENT;
+    }
+  }
+
+  CountMessageRead();
   co_return size;
 }
 
+template <typename WebSocketStream>
+awaitable<expected<size_t>>
+WebSocketTransport::CoreImpl<WebSocketStream>::read_some(std::span<char> data) {
+  if (data.empty())
+    co_return ERR_INVALID_ARGUMENT;
+
+  for (;;) {
+    auto [ec, bytes_read] = co_await websocket_.async_read_some(
+        boost::asio::buffer(data.data(), data.size()),
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+    if (ec == boost::beast::websocket::error::closed)
+      co_return size_t{0};
+    if (ec)
+      co_return MapError(ec);
+
+    CountBytesRead(bytes_read);
+    if (websocket_.is_message_done())
+      CountMessageRead();
+
+    // Skip empty frames in the middle of a message.
+    if (bytes_read != 0 || websocket_.is_message_done())
+      co_return bytes_read;
+  }
+}
+
+template <typename WebSocketStream>
+awaitable<error_code>
+WebSocketTransport::CoreImpl<WebSocketStream>::DiscardMessage() {
+  do {
+    auto [ec, bytes_read] = co_await websocket_.async_read_some(
+        discard_buffer_, kDiscardChunkSize,
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+    discard_buffer_.clear();
+    CountBytesRead(bytes_read);
+    if (ec)
+      co_return ec;
+  } while (!websocket_.is_message_done());
+
+  co_return OK;
+}
+
 template <typename WebSocketStream>
 awaitable<expected<size_t>> WebSocketTransport::CoreImpl<WebSocketStream>::write(
     std::span<const char> data) {
-  websocket_.text(true);
+  return write(data, binary_);
+}
+
+template <typename WebSocketStream>
+WebSocketMetrics WebSocketTransport::CoreImpl<WebSocketStream>::metrics()
+    const {
+  WebSocketMetrics metrics{.messages_read = messages_read_,
+                           .messages_written = messages_written_,
+                           .message_bytes_read = message_bytes_read_,
+                           .message_bytes_written = message_bytes_written_};
+  // Only `WebSocketStreamLayer` counts the wire bytes.
+  const auto& layer = websocket_.next_layer();
+  if constexpr (requires { layer.bytes_read(); }) {
+    metrics.wire_bytes_read = layer.bytes_read();
+    metrics.wire_bytes_written = layer.bytes_written();
+  }
+  return metrics;
+}
+
+template <typename WebSocketStream>
+awaitable<expected<size_t>> WebSocketTransport::CoreImpl<WebSocketStream>::write(
+    std::span<const char> data,
+    bool binary) {
+  websocket_.binary(binary);
   auto [ec, written] = co_await websocket_.async_write(
       boost::asio::buffer(data.data(), data.size()),
       boost::asio::as_tuple(boost::asio::use_awaitable));
   if (ec)
-    co_return ec;
+    co_return MapError(ec);
+  CountMessageWritten(written);
   co_return written;
 }
 
+template <typename WebSocketStream>
+awaitable<expected<size_t>> WebSocketTransport::CoreImpl<WebSocketStream>::write(
+    const WebSocketPreparedMessage& message) {
+  // Only `WebSocketStreamLayer` takes frames by reference.
+  auto& layer = websocket_.next_layer();
+  if constexpr (requires {
+                  layer.async_write_shared(
+                      std::shared_ptr<const void>{},
+                      boost::asio::const_buffer{},
+                      boost::asio::as_tuple(boost::asio::use_awaitable));
+                }) {
+    if (!server_)
+      co_return ERR_NOT_SUPPORTED;
+    // No frames may follow the closing frame.
+    if (!websocket_.is_open())
+      co_return ERR_CONNECTION_CLOSED;
+
+    auto [ec, _] = co_await layer.async_write_shared(
+        message.frames_, message.frame(shared_deflate_window_bits_),
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+    if (ec)
+      co_return MapError(ec);
+    CountMessageWritten(message.payload_size());
+    co_return message.payload_size();
+  } else {
+    co_return ERR_NOT_SUPPORTED;
+  }
+}
+
+template <typename WebSocketStream>
+void WebSocketTransport::CoreImpl<WebSocketStream>::CountBytesRead(
+    size_t bytes) {
+  message_bytes_read_ += bytes;
+  if (totals_)
+    totals_->message_bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+template <typename WebSocketStream>
+void WebSocketTransport::CoreImpl<WebSocketStream>::CountMessageRead() {
+  ++messages_read_;
+  if (totals_)
+    totals_->messages_read.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename WebSocketStream>
+void WebSocketTransport::CoreImpl<WebSocketStream>::CountMessageWritten(
+    size_t bytes) {
+  ++messages_written_;
+  message_bytes_written_ += bytes;
+  if (totals_) {
+    totals_->messages_written.fetch_add(1, std::memory_order_relaxed);
+    totals_->message_bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
 template <typename WebSocketStream>
 void WebSocketTransport::ApplyClientOptions(WebSocketStream& websocket) {
   namespace websocket_ns = boost::beast::websocket;
 
+  websocket.read_message_max(client_options_.max_message_size);
+  ApplyWriteOptions(websocket, client_options_.write);
   if (client_options_.enable_permessage_deflate) {
-    websocket_ns::permessage_deflate options;
-    options.client_enable = true;
-    options.server_enable = true;
-    websocket.set_option(options);
+    websocket.set_option(MakeDeflateOptions(client_options_.deflate));
   }
   if (client_options_.request_callback) {
     websocket.set_option(websocket_ns::stream_base::decorator(
@@ -234,6 +845,60 @@ void WebSocketTransport::ApplyClientOptions(WebSocketStream& websocket) {
   }
 }
 
+// static
+template <typename WebSocketStream>
+void WebSocketTransport::ApplyWriteOptions(
+    WebSocketStream& websocket,
+    const WebSocketWriteOptions& options) {
+  websocket.auto_fragment(options.auto_fragment);
+  // Beast rejects smaller buffers.
+  websocket.write_buffer_bytes(std::max<size_t>(options.buffer_bytes, 8));
+}
+
+template <typename Stream>
+awaitable<error_code> WebSocketTransport::OpenTlsClientStream(
+    Stream stream,
+    const std::string& handshake_host) {
+  const auto& server_name = client_options_.tls.has_value() &&
+                                    !client_options_.tls->server_name.empty()
+                                ? client_options_.tls->server_name
+                                : host_;
+  if (!tls_client_context_->SetServerName(stream.native_handle(), server_name))
+    co_return ERR_FAILED;
+  tls_client_context_->PrepareSession(stream.native_handle(), server_name);
+
+  auto handshake_error =
+      co_await HandshakeTls(stream, boost::asio::ssl::stream_base::client,
+                            client_options_.handshake_executor, std::nullopt);
+  if (handshake_error) {
+    tls_client_context_->ForgetSession(server_name);
+    co_return handshake_error;
+  }
+
+  tls_client_context_->OnHandshake(stream.native_handle());
+  if (SSL_session_reused(stream.native_handle()))
+    log_.write(LogSeverity::Normal, "TLS session resumed");
+
+  if constexpr (std::is_same_v<Stream, KernelTlsStream>) {
+    log_.write(LogSeverity::Normal, "Kernel TLS send: {}, receive: {}",
+               stream.kernel_send(), stream.kernel_receive());
+  }
+
+  co_return co_await OpenClientStream(std::move(stream), handshake_host);
+}
+
+template <typename Stream>
+awaitable<error_code> WebSocketTransport::OpenClientStream(
+    Stream stream,
+    const std::string& handshake_host) {
+  const auto& write_options = client_options_.write;
+  co_return co_await OpenConnectedClient(
+      boost::beast::websocket::stream<WebSocketStreamLayer<Stream>>{
+          write_options.batch_bytes, write_options.batch_delay,
+          std::move(stream)},
+      handshake_host);
+}
+
 template <typename NextLayer>
 awaitable<error_code> WebSocketTransport::OpenConnectedClient(
     boost::beast::websocket::stream<NextLayer> websocket,
@@ -253,24 +918,25 @@ awaitable<error_code> WebSocketTransport::OpenConnectedClient(
     auto validation_error = client_options_.response_validator(response);
     if (validation_error.has_value()) {
       boost::system::error_code ignored;
-      if constexpr (std::is_same_v<NextLayer, boost::asio::ip::tcp::socket>) {
-        websocket.next_layer().close(ignored);
-      } else {
-        websocket.next_layer().next_layer().close(ignored);
-      }
+      boost::beast::get_lowest_layer(websocket).close(ignored);
       co_return *validation_error;
     }
   }
 
+  if (client_options_.write.batching)
+    websocket.next_layer().start_batching();
+
   core_ = std::make_unique<CoreImpl<boost::beast::websocket::stream<NextLayer>>>(
-      std::move(websocket));
+      std::move(websocket),
+      WebSocketConnectionOptions{.binary = client_options_.binary,
+                                 .keepalive = client_options_.keepalive});
   connected_ = true;
   closed_ = false;
   co_return OK;
 }
 
 template <typename Stream>
-awaitable<void> WebSocketTransport::RejectRequest(
+awaitable<void> WebSocketTransport::WriteHttpResponse(
     Stream& stream,
     boost::beast::http::status status,
     std::string body,
@@ -287,17 +953,47 @@ awaitable<void> WebSocketTransport::RejectRequest(
       stream, response, boost::asio::as_tuple(boost::asio::use_awaitable));
   if (!ec) {
     boost::system::error_code ignored;
-    if constexpr (std::is_same_v<Stream, boost::asio::ip::tcp::socket>) {
-      stream.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
-    } else {
-      stream.next_layer().shutdown(
-          boost::asio::ip::tcp::socket::shutdown_both, ignored);
-    }
+    boost::beast::get_lowest_layer(stream).socket().shutdown(
+        boost::asio::ip::tcp::socket::shutdown_both, ignored);
   }
 }
 
+template <typename Stream>
+awaitable<WebSocketTransport::UpgradeResult>
+WebSocketTransport::AcceptTlsStream(
+    Stream stream) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + server_options_.handshake_timeout;
+  auto& lowest_layer = boost::beast::get_lowest_layer(stream);
+  // The timers of the stream fire on the transport executor, so an offloaded
+  // handshake has its own.
+  if (!server_options_.handshake_executor)
+    lowest_layer.expires_after(server_options_.handshake_timeout);
+
+  auto tls_error = co_await HandshakeTls(
+      stream, boost::asio::ssl::stream_base::server,
+      server_options_.handshake_executor, deadline);
+  if (tls_error)
+    co_return tls_error;
+
+  lowest_layer.expires_after(deadline - std::chrono::steady_clock::now());
+  co_return co_await AcceptStream(std::move(stream));
+}
+
+template <typename Stream>
+awaitable<WebSocketTransport::UpgradeResult>
+WebSocketTransport::AcceptStream(
+    Stream stream) {
+  const auto& write_options = server_options_.write;
+  co_return co_await AcceptUpgradedStream(
+      boost::beast::websocket::stream<WebSocketStreamLayer<Stream>>{
+          write_options.batch_bytes, write_options.batch_delay,
+          std::move(stream)});
+}
+
 template <typename NextLayer>
-awaitable<std::optional<any_transport>> WebSocketTransport::AcceptUpgradedStream(
+awaitable<WebSocketTransport::UpgradeResult>
+WebSocketTransport::AcceptUpgradedStream(
     boost::beast::websocket::stream<NextLayer> websocket) {
   namespace http = boost::beast::http;
   namespace websocket_ns = boost::beast::websocket;
@@ -310,59 +1006,132 @@ awaitable<std::optional<any_transport>> WebSocketTransport::AcceptUpgradedStream
       next_layer, buffer, request,
       boost::asio::as_tuple(boost::asio::use_awaitable));
   if (read_ec)
-    co_return std::nullopt;
+    co_return read_ec;
+
+  if (server_options_.serve_metrics && !websocket_ns::is_upgrade(request)) {
+    if (auto response = ServeHttpEndpoint(request)) {
+      ++server_metrics_.http_requests;
+      co_await WriteHttpResponse(next_layer, response->status,
+                                 std::move(response->body),
+                                 {{"Content-Type", response->content_type}});
+      co_return UpgradeResult{std::nullopt};
+    }
+  }
 
   if (!websocket_ns::is_upgrade(request)) {
-    co_await RejectRequest(
+    co_await WriteHttpResponse(
         next_layer,
         http::status::bad_request,
         "WebSocket upgrade required",
         {});
-    co_return std::nullopt;
+    co_return ERR_INVALID_ARGUMENT;
   }
 
   if (server_options_.handshake_callback) {
     auto rejection = server_options_.handshake_callback(request);
     if (rejection.has_value()) {
-      co_await RejectRequest(next_layer,
-                             rejection->status,
-                             std::move(rejection->body),
-                             rejection->headers);
-      co_return std::nullopt;
+      co_await WriteHttpResponse(next_layer,
+                                 rejection->status,
+                                 std::move(rejection->body),
+                                 rejection->headers);
+      co_return ERR_ACCESS_DENIED;
     }
   }
 
   websocket.set_option(websocket_ns::stream_base::timeout::suggested(
       boost::beast::role_type::server));
+  websocket.read_message_max(server_options_.max_message_size);
+  ApplyWriteOptions(websocket, server_options_.write);
   if (server_options_.enable_permessage_deflate) {
-    websocket_ns::permessage_deflate options;
-    options.server_enable = true;
-    options.client_enable = true;
-    websocket.set_option(options);
-  }
-  if (!server_options_.response_headers.empty()) {
-    websocket.set_option(websocket_ns::stream_base::decorator(
-        [headers = server_options_.response_headers,
-         callback = server_options_.response_callback](
-            websocket_ns::response_type& response) {
-          for (const auto& [name, value] : headers)
-            response.set(name, value);
-          if (callback)
-            callback(response);
-        }));
-  } else if (server_options_.response_callback) {
-    websocket.set_option(websocket_ns::stream_base::decorator(
-        [callback = server_options_.response_callback](
-            websocket_ns::response_type& response) { callback(response); }));
+    websocket.set_option(MakeDeflateOptions(server_options_.deflate));
   }
+  // The response carries the negotiated permessage-deflate.
+  auto shared_deflate_window_bits = std::make_shared<std::optional<int>>();
+  websocket.set_option(websocket_ns::stream_base::decorator(
+      [headers = server_options_.response_headers,
+       callback = server_options_.response_callback,
+       shared_deflate_window_bits](websocket_ns::response_type& response) {
+        for (const auto& [name, value] : headers)
+          response.set(name, value);
+        if (callback)
+          callback(response);
+        *shared_deflate_window_bits = GetSharedDeflateWindowBits(response);
+      }));
 
   auto [accept_ec] = co_await websocket.async_accept(
       request, boost::asio::as_tuple(boost::asio::use_awaitable));
   if (accept_ec)
-    co_return std::nullopt;
+    co_return accept_ec;
+
+  // The WebSocket timeouts take over from the handshake deadline.
+  boost::beast::get_lowest_layer(websocket).expires_never();
+  if (server_options_.write.batching)
+    websocket.next_layer().start_batching();
+
+  co_return UpgradeResult{any_transport{std::make_unique<WebSocketTransport>(
+      std::move(websocket),
+      WebSocketConnectionOptions{
+          .binary = server_options_.binary,
+          .keepalive = server_options_.keepalive,
+          .totals = connection_totals_,
+          .server = true,
+          .shared_deflate_window_bits = *shared_deflate_window_bits})}};
+}
+
+// static
+template <typename Stream>
+awaitable<error_code> WebSocketTransport::HandshakeTls(
+    Stream& stream,
+    boost::asio::ssl::stream_base::handshake_type type,
+    const std::optional<executor>& handshake_executor,
+    std::optional<std::chrono::steady_clock::time_point> deadline) {
+  if (!handshake_executor)
+    co_return co_await RunTlsHandshake(stream, type, std::nullopt);
+
+  // A strand serializes the handshake with its deadline. The completion
+  // resumes the caller on its own executor.
+  co_return co_await boost::asio::co_spawn(
+      boost::asio::make_strand(*handshake_executor),
+      RunTlsHandshake(stream, type, deadline), boost::asio::use_awaitable);
+}
+
+// static
+template <typename Stream>
+awaitable<error_code> WebSocketTransport::RunTlsHandshake(
+    Stream& stream,
+    boost::asio::ssl::stream_base::handshake_type type,
+    std::optional<std::chrono::steady_clock::time_point> deadline) {
+  if (!deadline) {
+    auto [error] = co_await stream.async_handshake(
+        type, boost::asio::as_tuple(boost::asio::use_awaitable));
+    co_return error;
+  }
+
+  // The timer handler may run after the handshake returns, so it touches the
+  // socket only while the handshake is pending. Both run on the strand.
+  struct Deadline {
+    bool done = false;
+    bool expired = false;
+  };
+  auto state = std::make_shared<Deadline>();
+  boost::asio::steady_timer timer{co_await boost::asio::this_coro::executor,
+                                  *deadline};
+  timer.async_wait(
+      [state, &socket = boost::beast::get_lowest_layer(stream).socket()](
+          error_code ec) {
+        if (ec || state->done)
+          return;
+        state->expired = true;
+        boost::system::error_code ignored;
+        socket.cancel(ignored);
+      });
+
+  auto [error] = co_await stream.async_handshake(
+      type, boost::asio::as_tuple(boost::asio::use_awaitable));
+  state->done = true;
+  timer.cancel();
 
-  co_return any_transport{
-      std::make_unique<WebSocketTransport>(std::move(websocket))};
+  co_return state->expired ? error_code{boost::beast::error::timeout} : error;
 }
 
 }  // namespace transport